@@ -0,0 +1,239 @@
+#include "q3bsp/Q3BspLoader.hpp"
+#include "q3bsp/Q3BspWorld.hpp"
+#include "renderer/Projection.hpp"
+#include "CameraPath.hpp"
+#include "Math.hpp"
+#include "Timer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Headless culling benchmark: replays a camera path through Q3BspWorld visibility
+ * determination and reports per-frame timings. No window, GL context or HMD needed.
+ */
+
+// per-frame benchmark results
+struct FrameResult
+{
+    double frameTime;     // CalculateVisibleFaces (microseconds)
+    int    cameraLeaf;
+    int    visibleFaces;
+    int    patchTriangles;  // curved surface triangles at the selected LODs
+};
+
+
+// camera path recorded by the viewer (-record) or a text file with one frame per line:
+// "px py pz vx vy vz ux uy uz" (viewer world units), lines starting with # are ignored
+static bool LoadCameraPath(const char *filename, std::vector<CameraPathFrame> &path)
+{
+    CameraPath recording;
+
+    if (recording.Load(filename))
+    {
+        path = recording.Frames();
+        return true;
+    }
+
+    std::ifstream pathFile(filename);
+
+    if (!pathFile.is_open())
+        return false;
+
+    std::string line;
+
+    while (std::getline(pathFile, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream lineStream(line);
+        CameraPathFrame frame;
+
+        if (!(lineStream >> frame.position.m_x >> frame.position.m_y >> frame.position.m_z
+                         >> frame.view.m_x     >> frame.view.m_y     >> frame.view.m_z
+                         >> frame.up.m_x       >> frame.up.m_y       >> frame.up.m_z))
+        {
+            printf("Malformed camera path line: %s\n", line.c_str());
+            return false;
+        }
+
+        frame.dt          = 0.f;
+        frame.right       = frame.view.CrossProduct(frame.up);
+        frame.renderFlags = 0;
+
+        path.push_back(frame);
+    }
+
+    return !path.empty();
+}
+
+
+// nearest-rank percentile of sorted values
+static double Percentile(const std::vector<double> &sortedValues, double p)
+{
+    size_t rank = (size_t)(p / 100.0 * sortedValues.size() + 0.5);
+    rank = std::min(std::max(rank, (size_t)1), sortedValues.size());
+
+    return sortedValues[rank - 1];
+}
+
+
+static void PrintUsage()
+{
+    printf("Usage: BspBench <path-to-bsp-file> <camera-path-file> [-loops N] [-fov degrees] [-aspect ratio] [-nopvs] [-nofc] [-nolod] [-csv output-file]\n");
+}
+
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    const char *mapFilename  = argv[1];
+    const char *pathFilename = argv[2];
+    const char *csvFilename  = NULL;
+    int   numLoops = 1;
+    float fov      = 75.f;
+    float scrRatio = 16.f / 9.f;
+    bool  skipPVS  = false;
+    bool  skipFC   = false;
+    bool  skipLod  = false;
+
+    for (int i = 3; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-loops") && (i + 1 < argc))
+            numLoops = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "-fov") && (i + 1 < argc))
+            fov = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "-aspect") && (i + 1 < argc))
+            scrRatio = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "-csv") && (i + 1 < argc))
+            csvFilename = argv[++i];
+        else if (!strcmp(argv[i], "-nopvs"))
+            skipPVS = true;
+        else if (!strcmp(argv[i], "-nofc"))
+            skipFC = true;
+        else if (!strcmp(argv[i], "-nolod"))
+            skipLod = true;
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    std::vector<CameraPathFrame> path;
+
+    if (!LoadCameraPath(pathFilename, path))
+    {
+        printf("Could not load camera path: %s\n", pathFilename);
+        return 1;
+    }
+
+    Q3BspLoader loader;
+    Q3BspWorld  q3map;
+
+    if (!loader.Load(mapFilename, &q3map))
+    {
+        printf("Could not load map: %s\n", mapFilename);
+        return 1;
+    }
+
+    q3map.Init();
+
+    // flags forced from the command line, on top of the ones recorded in the path
+    int forcedFlags = (skipPVS ? Q3RenderSkipPVS : 0) | (skipFC ? Q3RenderSkipFC : 0) | (skipLod ? Q3RenderSkipPatchLod : 0);
+
+    // same projection as the non-VR viewer (see Camera::UpdateProjectionMatrix)
+    Math::Matrix4f projectionMatrix;
+    Renderer::MakePerspective(projectionMatrix, fov * PIdiv180, scrRatio, 0.1f, 1000.f);
+
+    std::vector<FrameResult> results;
+    results.reserve(path.size() * numLoops);
+
+    for (int loop = 0; loop < numLoops; ++loop)
+    {
+        for (const auto &frame : path)
+        {
+            // replay render flag toggles
+            int changedFlags = (frame.renderFlags | forcedFlags) ^ q3map.GetRenderFlags();
+
+            for (int flag = 1; changedFlags != 0; flag <<= 1)
+            {
+                if (changedFlags & flag)
+                {
+                    q3map.ToggleRenderFlag(flag);
+                    changedFlags &= ~flag;
+                }
+            }
+
+            Math::Matrix4f viewMatrix;
+            Renderer::MakeView(viewMatrix, frame.position, frame.view, frame.up);
+
+            Timer frameTimer;
+
+            q3map.CalculateVisibleFaces(frame.position, viewMatrix * projectionMatrix);
+
+            FrameResult result;
+            result.frameTime      = frameTimer.ElapsedMs() * 1000.0;
+            result.cameraLeaf     = q3map.CameraLeaf();
+            result.visibleFaces   = q3map.GetMapStats().visibleFaces;
+            result.patchTriangles = q3map.GetMapStats().visiblePatchTriangles;
+
+            results.push_back(result);
+        }
+    }
+
+    if (csvFilename)
+    {
+        std::ofstream csvFile(csvFilename);
+        csvFile << "frame,time_us,camera_leaf,visible_faces,patch_triangles\n";
+
+        for (size_t i = 0; i < results.size(); ++i)
+            csvFile << i << "," << results[i].frameTime << "," << results[i].cameraLeaf << "," << results[i].visibleFaces << "," << results[i].patchTriangles << "\n";
+    }
+
+    // summary
+    std::vector<double> frameTimes;
+    double totalTime    = 0.0;
+    long long totalFaces = 0;
+    long long totalPatchTriangles = 0;
+    int minFaces = results[0].visibleFaces;
+    int maxFaces = results[0].visibleFaces;
+
+    for (const auto &r : results)
+    {
+        frameTimes.push_back(r.frameTime);
+        totalTime  += r.frameTime;
+        totalFaces += r.visibleFaces;
+        totalPatchTriangles += r.patchTriangles;
+        minFaces = std::min(minFaces, r.visibleFaces);
+        maxFaces = std::max(maxFaces, r.visibleFaces);
+    }
+
+    std::sort(frameTimes.begin(), frameTimes.end());
+
+    const BspStats &stats = q3map.GetMapStats();
+
+    printf("Map: %s (%d faces, %d patches, loaded in %.2f ms%s)\n", mapFilename, stats.totalFaces, stats.totalPatches,
+           stats.loadTimeTotal, stats.loadedFromCache ? ", cached" : "");
+    printf("Path: %s (%d frames x %d loops)%s%s%s\n", pathFilename, (int)path.size(), numLoops,
+           skipPVS ? " [no PVS]" : "", skipFC ? " [no frustum culling]" : "", skipLod ? " [no patch LOD]" : "");
+    printf("Frame time (us): min %.2f  mean %.2f  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+           frameTimes.front(), totalTime / results.size(), Percentile(frameTimes, 50.0), Percentile(frameTimes, 90.0),
+           Percentile(frameTimes, 99.0), frameTimes.back());
+    printf("Visible faces: min %d  mean %.1f  max %d\n", minFaces, (double)totalFaces / results.size(), maxFaces);
+    printf("Patch triangles: mean %.1f\n", (double)totalPatchTriangles / results.size());
+    printf("PVS cache hits/misses: %d/%d\n", stats.pvsCacheHits, stats.pvsCacheMisses);
+
+    return 0;
+}
\ No newline at end of file
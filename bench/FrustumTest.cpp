@@ -0,0 +1,192 @@
+#include "Frustum.hpp"
+#include "renderer/Projection.hpp"
+#include "Math.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/*
+ * Consistency test for the batched (SSE) frustum culling kernel: Frustum::BoxesInFrustum has to agree with
+ * the scalar center/extent test and the 8 corner reference test on randomized boxes and view matrices.
+ */
+
+static const int   s_numViews   = 200;
+static const int   s_numBoxes   = 1031;  // not a multiple of 4 - the scalar tail is exercised too
+static const float s_fov        = 75.f;
+static const float s_scrRatio   = 16.f / 9.f;
+static const float s_tolerance  = 1e-3f; // boxes this close to a plane may be classified either way
+
+
+static float RandomFloat(float min, float max)
+{
+    return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+
+static Math::Vector3f RandomDirection()
+{
+    Math::Vector3f dir;
+
+    do
+    {
+        dir = Math::Vector3f(RandomFloat(-1.f, 1.f), RandomFloat(-1.f, 1.f), RandomFloat(-1.f, 1.f));
+    }
+    while (dir.DotProduct(dir) < 0.01f);
+
+    dir.Normalize();
+    return dir;
+}
+
+
+// 8 corner reference test of a box grown (or shrunk, for negative delta) on all sides
+static bool CornerTest(const Frustum &frustum, const BoxListSoA &boxes, int b, float delta)
+{
+    float ex = std::max(boxes.extentX[b] + delta, 0.f);
+    float ey = std::max(boxes.extentY[b] + delta, 0.f);
+    float ez = std::max(boxes.extentZ[b] + delta, 0.f);
+
+    Math::Vector3f corners[8];
+
+    for (int c = 0; c < 8; ++c)
+    {
+        corners[c].m_x = boxes.centerX[b] + ((c & 4) ? ex : -ex);
+        corners[c].m_y = boxes.centerY[b] + ((c & 2) ? ey : -ey);
+        corners[c].m_z = boxes.centerZ[b] + ((c & 1) ? ez : -ez);
+    }
+
+    return frustum.BoxInFrustum(corners);
+}
+
+
+int main()
+{
+    srand(1234);
+
+    Math::Matrix4f projectionMatrix;
+    Renderer::MakePerspective(projectionMatrix, s_fov * PIdiv180, s_scrRatio, 0.1f, 1000.f);
+
+    float tanY = tanf(s_fov * PIdiv180 * 0.5f);
+    float tanX = tanY * s_scrRatio;
+
+    int numTested    = 0;
+    int numVisible   = 0;
+    int numAmbiguous = 0;
+    int numFailed    = 0;
+
+    for (int view = 0; view < s_numViews; ++view)
+    {
+        Math::Vector3f eye(RandomFloat(-50.f, 50.f), RandomFloat(-50.f, 50.f), RandomFloat(-50.f, 50.f));
+        Math::Vector3f dir = RandomDirection();
+        Math::Vector3f up  = RandomDirection();
+
+        if (fabs(dir.DotProduct(up)) > 0.99f)
+            up = fabs(dir.m_z) < 0.9f ? Math::Vector3f(0.f, 0.f, 1.f) : Math::Vector3f(1.f, 0.f, 0.f);
+
+        Math::Matrix4f viewMatrix;
+        Renderer::MakeView(viewMatrix, eye, dir, up);
+
+        Frustum frustum;
+        frustum.Update(viewMatrix * projectionMatrix);
+
+        // camera basis as set up by MakeView
+        Math::Vector3f right = dir.CrossProduct(up);
+        right.Normalize();
+        Math::Vector3f camUp = right.CrossProduct(dir);
+
+        BoxListSoA boxes;
+        boxes.Resize(s_numBoxes);
+
+        for (int b = 0; b < s_numBoxes; ++b)
+        {
+            Math::Vector3f center;
+            Math::Vector3f extent(RandomFloat(0.f, 4.f), RandomFloat(0.f, 4.f), RandomFloat(0.f, 4.f));
+
+            switch (b % 4)
+            {
+            case 0:
+                // anywhere around the camera
+                center = Math::Vector3f(RandomFloat(-100.f, 100.f), RandomFloat(-100.f, 100.f), RandomFloat(-100.f, 100.f));
+                break;
+            case 1:
+            {
+                // centered on one of the side planes - straddles it
+                float depth = RandomFloat(1.f, 100.f);
+                float sx = (rand() & 1) ? 1.f : -1.f;
+                float sy = RandomFloat(-1.f, 1.f);
+
+                if (rand() & 1)
+                    center = eye + dir * depth + right * (sx * tanX * depth) + camUp * (sy * tanY * depth);
+                else
+                    center = eye + dir * depth + right * (sy * tanX * depth) + camUp * (sx * tanY * depth);
+                break;
+            }
+            case 2:
+                // behind the camera or beyond the far plane
+                center = eye + dir * ((rand() & 1) ? RandomFloat(-100.f, -5.f) : RandomFloat(995.f, 1100.f)) + RandomDirection() * RandomFloat(0.f, 20.f);
+                break;
+            default:
+                // degenerate (flat or point) boxes
+                center = Math::Vector3f(RandomFloat(-100.f, 100.f), RandomFloat(-100.f, 100.f), RandomFloat(-100.f, 100.f));
+                extent.m_x = (rand() & 1) ? 0.f : extent.m_x;
+                extent.m_y = 0.f;
+                extent.m_z = (rand() & 1) ? 0.f : extent.m_z;
+                break;
+            }
+
+            boxes.Set(b, center - extent, center + extent);
+        }
+
+        // culling runs on index lists - shuffle them and test all counts that leave a tail of 0-3 boxes
+        std::vector<int> indices(s_numBoxes);
+
+        for (int b = 0; b < s_numBoxes; ++b)
+            indices[b] = b;
+
+        std::random_shuffle(indices.begin(), indices.end());
+
+        int count = (view < 16) ? view : s_numBoxes - (view % 4);
+        std::vector<unsigned char> visible(count + 1, 0xcd);
+        frustum.BoxesInFrustum(boxes, indices.data(), count, visible.data());
+
+        if (visible[count] != 0xcd)
+        {
+            printf("View %d: BoxesInFrustum wrote past %d results\n", view, count);
+            numFailed++;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            int b = indices[i];
+            bool scalar    = frustum.BoxInFrustum(boxes, b);
+            bool reference = CornerTest(frustum, boxes, b, 0.f);
+
+            numTested++;
+            numVisible += visible[i] ? 1 : 0;
+
+            if (visible[i] > 1)
+            {
+                printf("View %d, box %d: invalid result %d\n", view, b, visible[i]);
+                numFailed++;
+            }
+            else if ((visible[i] != 0) != scalar || (visible[i] != 0) != reference)
+            {
+                // rounding differs between the kernels - only boxes touching a plane may disagree
+                if (CornerTest(frustum, boxes, b, s_tolerance) != CornerTest(frustum, boxes, b, -s_tolerance))
+                {
+                    numAmbiguous++;
+                    continue;
+                }
+
+                printf("View %d, box %d: batched %d, scalar %d, corners %d\n", view, b, visible[i], scalar, reference);
+                numFailed++;
+            }
+        }
+    }
+
+    printf("Frustum test: %d boxes tested (%d visible, %d within %g of a plane), %d failures\n",
+           numTested, numVisible, numAmbiguous, s_tolerance, numFailed);
+
+    return numFailed == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -1,10 +1,13 @@
 #include <SDL.h>
 #include "Application.hpp"
 #include "StringHelpers.hpp"
+#include "Trace.hpp"
 #include "renderer/CameraDirector.hpp"
+#include "renderer/FrameProfiler.hpp"
 #include "renderer/RenderContext.hpp"
 #include "renderer/ShaderManager.hpp"
 #include "q3bsp/Q3BspLoader.hpp"
+#include "q3bsp/Q3BspMap.hpp"
 #include "q3bsp/Q3BspStatsUI.hpp"
 #include "renderer/OculusVR.hpp"
 
@@ -26,13 +29,28 @@ void Application::OnStart(int argc, char **argv, bool vrMode)
     m_VREnabled = vrMode;   
     glEnable(GL_MULTISAMPLE);
 
+    // evaluate curved surfaces in tesselation shaders
+    bool gpuTesselation = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-gputess"))
+            gpuTesselation = true;
+    }
+
     Q3BspLoader loader;
     // assume the parameter with a string ".bsp" is the map we want to load
     for (int i = 1; i < argc; ++i)
     {
         if (std::string(argv[i]).find(".bsp") != std::string::npos)
         {
-            m_q3map = loader.Load(argv[i]);
+            Q3BspMap *q3map = new Q3BspMap(gpuTesselation);
+
+            if (loader.Load(argv[i], q3map))
+                m_q3map = q3map;
+            else
+                delete q3map;
+
             break;
         }
     }
@@ -57,6 +75,28 @@ void Application::OnStart(int argc, char **argv, bool vrMode)
     g_cameraDirector.GetActiveCamera()->SetMode(Camera::CAM_FPS);
 
     m_q3stats = new Q3StatsUI(m_q3map);
+
+    // camera path recording/playback
+    for (int i = 1; i < argc - 1; ++i)
+    {
+        if (!strcmp(argv[i], "-record"))
+        {
+            if (!m_cameraPath.StartRecording(argv[i + 1]))
+                LOG_MESSAGE("[Application] Could not open camera path for recording: " << argv[i + 1]);
+        }
+
+        if (!strcmp(argv[i], "-replay"))
+        {
+            if (m_cameraPath.Load(argv[i + 1]))
+                m_replayFrame = 0;
+            else
+                LOG_MESSAGE("[Application] Could not load camera path: " << argv[i + 1]);
+        }
+
+        // zone trace written on exit
+        if (!strcmp(argv[i], "-trace"))
+            m_traceFilename = argv[i + 1];
+    }
 }
 
 
@@ -65,9 +105,14 @@ void Application::OnRender()
     //update global MVP matrix in primary shader    
     glUniformMatrix4fv(ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader).uniforms[ModelViewProjectionMatrix], 1, GL_FALSE, &(g_renderContext.ModelViewProjectionMatrix[0]));
 
+    if (ShaderManager::GetInstance()->GetShaderProgram(ShaderManager::BasicTessShader).id != 0)
+        glUniformMatrix4fv(ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicTessShader).uniforms[ModelViewProjectionMatrix], 1, GL_FALSE, &(g_renderContext.ModelViewProjectionMatrix[0]));
+
     // render the bsp
     if (m_q3map)
     {
+        ProfileScope profile(ProfileRender, true);
+
         // no need to calculate separate view matrix if we're in VR (OVR handles it for us)
         if (!VREnabled())
         {
@@ -86,8 +131,11 @@ void Application::OnRender()
     switch (m_debugRenderState)
     {
     case RenderMapStats:
+    {
+        ProfileScope profile(ProfileStatsUI, true);
         m_q3stats->Render();
         break;
+    }
     case RenderVRData:
         g_oculusVR.RenderDebug();
         break;
@@ -101,11 +149,53 @@ void Application::OnRender()
 
 void Application::OnUpdate(float dt)
 {
-    UpdateCamera(dt);
+    TRACE_SCOPE("OnUpdate");
+    ProfileScope profile(ProfileUpdate);
+
+    // replay ignores live input and wall clock - every frame comes from the recording
+    if (m_replayFrame >= 0)
+    {
+        if (m_replayFrame == (int)m_cameraPath.Frames().size())
+        {
+            LOG_MESSAGE("[Application] Camera path replay finished (" << m_replayFrame << " frames)");
+            Terminate();
+            return;
+        }
+
+        ReplayCameraFrame();
+    }
+    else
+    {
+        UpdateCamera(dt);
+    }
+
+    if (m_cameraPath.IsRecording())
+        RecordCameraFrame(dt);
 
-    // determine which faces are visible
     if (m_q3map)
-        m_q3map->CalculateVisibleFaces(g_cameraDirector.GetActiveCamera()->Position());
+    {
+        m_q3map->OnFrameStart();
+
+        // determine which faces are visible (once per frame - in VR the culling frustum covers both eyes)
+        Math::Vector3f camPos = g_cameraDirector.GetActiveCamera()->Position();
+        Math::Matrix4f cullingMatrix;
+
+        if (VREnabled())
+        {
+            OVR::Matrix4f OVRCullMVP = (g_oculusVR.GetStereoCullingMatrix() * OVR::Matrix4f(OVR::Quatf(OVR::Vector3f(1.0, 0.0, 0.0), -PIdiv2)) // rotate 90 degrees by X axis (BSP world is flipped)
+                                                                            * OVR::Matrix4f::Translation(-OVR::Vector3f(camPos.m_x, camPos.m_y, camPos.m_z))).Transposed();
+            cullingMatrix = Math::Matrix4f(&OVRCullMVP.M[0][0]);
+        }
+        else
+        {
+            g_cameraDirector.GetActiveCamera()->OnRender();
+            cullingMatrix = g_cameraDirector.GetActiveCamera()->ViewMatrix() * g_cameraDirector.GetActiveCamera()->ProjectionMatrix();
+        }
+
+        FrameProfiler::GetInstance()->BeginCpu(ProfileVisibleSet);
+        m_q3map->CalculateVisibleFaces(camPos, cullingMatrix);
+        FrameProfiler::GetInstance()->EndCpu(ProfileVisibleSet);
+    }
 
     if (VREnabled())
     {
@@ -116,6 +206,11 @@ void Application::OnUpdate(float dt)
 
 void Application::OnTerminate()
 {
+    m_cameraPath.StopRecording();
+
+    if (!m_traceFilename.empty() && !TRACE_WRITE(m_traceFilename))
+        LOG_MESSAGE("[Application] Could not write trace: " << m_traceFilename);
+
     delete m_q3map;
     delete m_q3stats;
 }
@@ -138,33 +233,43 @@ void Application::OnKeyPress(KeyCode key)
     switch (key)
     {
     case KEY_F1:
-        m_q3map->ToggleRenderFlag(Q3RenderShowWireframe);
+        ToggleRenderFlag(Q3RenderShowWireframe);
         break;
     case KEY_F2:
-        m_q3map->ToggleRenderFlag(Q3RenderShowLightmaps);
-        glUniform1i(ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader).uniforms[RenderLightmaps], m_q3map->HasRenderFlag(Q3RenderShowLightmaps) ? 1 : 0);
+        ToggleRenderFlag(Q3RenderShowLightmaps);
         break;
     case KEY_F3:
-        m_q3map->ToggleRenderFlag(Q3RenderUseLightmaps);
-        glUniform1i(ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader).uniforms[UseLightmaps], m_q3map->HasRenderFlag(Q3RenderUseLightmaps) ? 1 : 0);
+        ToggleRenderFlag(Q3RenderUseLightmaps);
         break;
     case KEY_F4:
-        m_q3map->ToggleRenderFlag(Q3RenderAlphaTest);
-        glUniform1i(ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader).uniforms[UseAlphaTest], m_q3map->HasRenderFlag(Q3RenderAlphaTest) ? 1 : 0);
+        ToggleRenderFlag(Q3RenderAlphaTest);
         break;
     case KEY_F5:
-        m_q3map->ToggleRenderFlag(Q3RenderSkipMissingTex);
+        ToggleRenderFlag(Q3RenderSkipMissingTex);
         break;
     case KEY_F6:
-        m_q3map->ToggleRenderFlag(Q3RenderSkipPVS);
+        ToggleRenderFlag(Q3RenderSkipPVS);
         break;
     case KEY_F7:
-        m_q3map->ToggleRenderFlag(Q3RenderSkipFC);
+        ToggleRenderFlag(Q3RenderSkipFC);
         break;
     case KEY_F8:
         if (VREnabled())
             g_oculusVR.SetMSAA(!g_oculusVR.MSAAEnabled());
         break;
+    case KEY_F9:
+        if (FrameProfiler::GetInstance()->CsvCaptureActive())
+            FrameProfiler::GetInstance()->StopCsvCapture();
+        else if (!FrameProfiler::GetInstance()->StartCsvCapture("frametimes.csv"))
+            LOG_MESSAGE("[Application] Could not open frametimes.csv for writing");
+        break;
+    case KEY_F11:
+        ToggleRenderFlag(Q3RenderSkipPatchLod);
+        break;
+    case KEY_F10:
+        if (!TRACE_WRITE("trace.json"))
+            LOG_MESSAGE("[Application] Could not write trace.json");
+        break;
     case KEY_TILDE:
         m_debugRenderState++;
         if (!VREnabled())
@@ -233,7 +338,7 @@ void Application::OnKeyRelease(KeyCode key)
 
 void Application::OnMouseMove(int x, int y)
 {
-    if (!VREnabled())
+    if (!VREnabled() && m_replayFrame < 0)
     {
         g_cameraDirector.GetActiveCamera()->OnMouseMove(x, y);
     }
@@ -273,6 +378,85 @@ void Application::UpdateCamera(float dt)
 }
 
 
+void Application::ToggleRenderFlag(int flag)
+{
+    if (!m_q3map)
+        return;
+
+    m_q3map->ToggleRenderFlag(flag);
+
+    // map shaders share the fragment stage, so they share the flag uniforms too
+    static const ShaderManager::ShaderName mapShaders[] = { ShaderManager::BasicShader, ShaderManager::BasicTessShader };
+
+    for (auto shaderName : mapShaders)
+    {
+        if (ShaderManager::GetInstance()->GetShaderProgram(shaderName).id == 0)
+            continue;
+
+        const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(shaderName);
+
+        switch (flag)
+        {
+        case Q3RenderShowLightmaps:
+            glUniform1i(shader.uniforms[RenderLightmaps], m_q3map->HasRenderFlag(Q3RenderShowLightmaps) ? 1 : 0);
+            break;
+        case Q3RenderUseLightmaps:
+            glUniform1i(shader.uniforms[UseLightmaps], m_q3map->HasRenderFlag(Q3RenderUseLightmaps) ? 1 : 0);
+            break;
+        case Q3RenderAlphaTest:
+            glUniform1i(shader.uniforms[UseAlphaTest], m_q3map->HasRenderFlag(Q3RenderAlphaTest) ? 1 : 0);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+
+void Application::RecordCameraFrame(float dt)
+{
+    const Camera *camera = g_cameraDirector.GetActiveCamera();
+
+    CameraPathFrame frame;
+    frame.dt          = dt;
+    frame.position    = camera->Position();
+    frame.view        = camera->ViewVector();
+    frame.up          = camera->UpVector();
+    frame.right       = camera->RightVector();
+    frame.renderFlags = m_q3map ? m_q3map->GetRenderFlags() : 0;
+
+    m_cameraPath.RecordFrame(frame);
+}
+
+
+// drive the active camera and render flags from the next recorded frame
+void Application::ReplayCameraFrame()
+{
+    const CameraPathFrame &frame = m_cameraPath.Frames()[m_replayFrame++];
+    Camera *camera = g_cameraDirector.GetActiveCamera();
+
+    camera->SetPosition(frame.position);
+    camera->SetViewVector(frame.view.m_x, frame.view.m_y, frame.view.m_z);
+    camera->SetUpVector(frame.up.m_x, frame.up.m_y, frame.up.m_z);
+    camera->SetRightVector(frame.right.m_x, frame.right.m_y, frame.right.m_z);
+
+    if (!m_q3map)
+        return;
+
+    // apply render flag toggles made during recording
+    int changedFlags = frame.renderFlags ^ m_q3map->GetRenderFlags();
+
+    for (int flag = 1; changedFlags != 0; flag <<= 1)
+    {
+        if (changedFlags & flag)
+        {
+            ToggleRenderFlag(flag);
+            changedFlags &= ~flag;
+        }
+    }
+}
+
+
 Math::Vector3f Application::FindPlayerStart(const char *entities)
 {
     std::string str(entities);
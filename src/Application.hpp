@@ -2,6 +2,7 @@
 #define APPLICATION_INCLUDED
 
 #include <map>
+#include "CameraPath.hpp"
 #include "InputHandlers.hpp"
 #include "Math.hpp"
 
@@ -27,7 +28,7 @@ public:
         MM_Count
     };
 
-    Application() : m_running(true), m_mirrorMode(Mirror_Regular), m_VREnabled(false), m_q3map(NULL), m_q3stats(NULL), m_debugRenderState(RenderMapStats)
+    Application() : m_running(true), m_mirrorMode(Mirror_Regular), m_VREnabled(false), m_q3map(NULL), m_q3stats(NULL), m_replayFrame(-1), m_debugRenderState(RenderMapStats)
     {
     }
 
@@ -49,6 +50,11 @@ public:
     const VRMirrorMode CurrMirrorMode() const { return (VRMirrorMode)m_mirrorMode; }
 private:
     void UpdateCamera( float dt );
+    void ToggleRenderFlag(int flag);   // toggle map render flag and update dependent shader state
+
+    // camera path recording/playback (-record <file>, -replay <file>)
+    void RecordCameraFrame(float dt);
+    void ReplayCameraFrame();
     inline void SetKeyPressed(KeyCode key, bool pressed) { m_keyStates[key] = pressed; }
 
     // helper functions for parsing Quake entities
@@ -65,6 +71,10 @@ private:
     BspMap  *m_q3map;    // loaded map
     StatsUI *m_q3stats;  // map stats UI
 
+    CameraPath  m_cameraPath;    // recorded or replayed camera path
+    int         m_replayFrame;   // next frame to replay (-1 if not replaying)
+    std::string m_traceFilename; // zone trace written on exit (-trace)
+
     enum DebugRender
     {
         None = 0,
@@ -0,0 +1,66 @@
+#include "CameraPath.hpp"
+#include <cstring>
+
+const int CameraPath::s_version = 1;
+
+static const char s_pathMagic[4] = { 'C', 'P', 'T', 'H' };
+
+
+bool CameraPath::Load(const std::string &filename)
+{
+    std::ifstream pathFile(filename, std::ios::in | std::ios::binary);
+
+    if (!pathFile.is_open())
+        return false;
+
+    char magic[4];
+    int  version = 0;
+
+    pathFile.read(magic, sizeof(magic));
+    pathFile.read((char *)&version, sizeof(int));
+
+    if (!pathFile || memcmp(magic, s_pathMagic, 4) || version != s_version)
+        return false;
+
+    m_frames.clear();
+
+    CameraPathFrame frame;
+
+    // a partially written trailing record (interrupted recording) is dropped
+    while (pathFile.read((char *)&frame, sizeof(CameraPathFrame)))
+        m_frames.push_back(frame);
+
+    return !m_frames.empty();
+}
+
+
+bool CameraPath::StartRecording(const std::string &filename)
+{
+    StopRecording();
+
+    m_recordFile.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (!m_recordFile.is_open())
+        return false;
+
+    m_recordFile.write(s_pathMagic, sizeof(s_pathMagic));
+    m_recordFile.write((const char *)&s_version, sizeof(int));
+
+    return m_recordFile.good();
+}
+
+
+void CameraPath::RecordFrame(const CameraPathFrame &frame)
+{
+    if (!m_recordFile.is_open())
+        return;
+
+    m_recordFile.write((const char *)&frame, sizeof(CameraPathFrame));
+}
+
+
+void CameraPath::StopRecording()
+{
+    if (m_recordFile.is_open())
+        m_recordFile.close();
+}
\ No newline at end of file
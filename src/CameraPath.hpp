@@ -0,0 +1,48 @@
+#ifndef CAMERAPATH_HPP
+#define CAMERAPATH_HPP
+
+#include "Math.hpp"
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+ * Recorded camera path (.campath): per-frame timestep, camera pose and map render flags.
+ * Binary file - header followed by raw CameraPathFrame records until EOF. Frames are
+ * written as they are recorded, so a session that ends abruptly still leaves a valid file.
+ */
+
+struct CameraPathFrame
+{
+    float          dt;           // frame timestep (seconds)
+    Math::Vector3f position;     // camera position (viewer world units)
+    Math::Vector3f view;         // camera orientation vectors
+    Math::Vector3f up;
+    Math::Vector3f right;
+    int            renderFlags;  // BspMap render flags (Q3BspRenderFlags) active in this frame
+};
+
+
+class CameraPath
+{
+public:
+    static const int s_version;
+
+    ~CameraPath() { StopRecording(); }
+
+    // read a whole recording for playback
+    bool Load(const std::string &filename);
+
+    bool StartRecording(const std::string &filename);
+    void RecordFrame(const CameraPathFrame &frame);
+    void StopRecording();
+
+    bool IsRecording() const { return m_recordFile.is_open(); }
+    const std::vector<CameraPathFrame> &Frames() const { return m_frames; }
+
+private:
+    std::vector<CameraPathFrame> m_frames;
+    std::ofstream m_recordFile;
+};
+
+#endif
\ No newline at end of file
@@ -1,20 +1,22 @@
 #include "Frustum.hpp"
-#include "renderer/RenderContext.hpp"
 
-extern RenderContext g_renderContext;
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define FRUSTUM_SSE
+#include <emmintrin.h>
+#endif
 
-void Frustum::OnRender()
+void Frustum::Update(const Math::Matrix4f &mvpMatrix)
 {
     // extract each plane from MVP matrix
-    ExtractPlane(m_planes[0], g_renderContext.ModelViewProjectionMatrix,  1);
-    ExtractPlane(m_planes[1], g_renderContext.ModelViewProjectionMatrix, -1);
-    ExtractPlane(m_planes[2], g_renderContext.ModelViewProjectionMatrix,  2);
-    ExtractPlane(m_planes[3], g_renderContext.ModelViewProjectionMatrix, -2);
-    ExtractPlane(m_planes[4], g_renderContext.ModelViewProjectionMatrix,  3);
-    ExtractPlane(m_planes[5], g_renderContext.ModelViewProjectionMatrix, -3);
+    ExtractPlane(m_planes[0], mvpMatrix,  1);
+    ExtractPlane(m_planes[1], mvpMatrix, -1);
+    ExtractPlane(m_planes[2], mvpMatrix,  2);
+    ExtractPlane(m_planes[3], mvpMatrix, -2);
+    ExtractPlane(m_planes[4], mvpMatrix,  3);
+    ExtractPlane(m_planes[5], mvpMatrix, -3);
 }
 
-bool Frustum::BoxInFrustum(const Math::Vector3f *vertices)
+bool Frustum::BoxInFrustum(const Math::Vector3f *vertices) const
 {
     for (int i = 0; i < 6; ++i)
     {
@@ -41,6 +43,112 @@ bool Frustum::BoxInFrustum(const Math::Vector3f *vertices)
     return true;
 }
 
+// center/extent test - box is outside if its most positive point along the plane normal is behind the plane
+bool Frustum::BoxInFrustum(const BoxListSoA &boxes, int idx) const
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        const Plane &p = m_planes[i];
+
+        float dist = p.A * boxes.centerX[idx] + p.B * boxes.centerY[idx] + p.C * boxes.centerZ[idx] + p.D +
+                     fabs(p.A) * boxes.extentX[idx] + fabs(p.B) * boxes.extentY[idx] + fabs(p.C) * boxes.extentZ[idx];
+
+        if (dist <= 0)
+            return false;
+    }
+
+    return true;
+}
+
+// test boxes[indices[i]] for i < count and store results in visible[i] (4 boxes at a time with SSE)
+void Frustum::BoxesInFrustum(const BoxListSoA &boxes, const int *indices, int count, unsigned char *visible) const
+{
+    int i = 0;
+
+#ifdef FRUSTUM_SSE
+    const __m128 zero    = _mm_setzero_ps();
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+    __m128 planeA[6], planeB[6], planeC[6], planeD[6], absA[6], absB[6], absC[6];
+
+    for (int p = 0; p < 6; ++p)
+    {
+        planeA[p] = _mm_set1_ps(m_planes[p].A);
+        planeB[p] = _mm_set1_ps(m_planes[p].B);
+        planeC[p] = _mm_set1_ps(m_planes[p].C);
+        planeD[p] = _mm_set1_ps(m_planes[p].D);
+        absA[p]   = _mm_and_ps(planeA[p], absMask);
+        absB[p]   = _mm_and_ps(planeB[p], absMask);
+        absC[p]   = _mm_and_ps(planeC[p], absMask);
+    }
+
+    for (; i + 4 <= count; i += 4)
+    {
+        const int *idx = indices + i;
+
+        // gather 4 boxes into SSE lanes
+        __m128 cx = _mm_set_ps(boxes.centerX[idx[3]], boxes.centerX[idx[2]], boxes.centerX[idx[1]], boxes.centerX[idx[0]]);
+        __m128 cy = _mm_set_ps(boxes.centerY[idx[3]], boxes.centerY[idx[2]], boxes.centerY[idx[1]], boxes.centerY[idx[0]]);
+        __m128 cz = _mm_set_ps(boxes.centerZ[idx[3]], boxes.centerZ[idx[2]], boxes.centerZ[idx[1]], boxes.centerZ[idx[0]]);
+        __m128 ex = _mm_set_ps(boxes.extentX[idx[3]], boxes.extentX[idx[2]], boxes.extentX[idx[1]], boxes.extentX[idx[0]]);
+        __m128 ey = _mm_set_ps(boxes.extentY[idx[3]], boxes.extentY[idx[2]], boxes.extentY[idx[1]], boxes.extentY[idx[0]]);
+        __m128 ez = _mm_set_ps(boxes.extentZ[idx[3]], boxes.extentZ[idx[2]], boxes.extentZ[idx[1]], boxes.extentZ[idx[0]]);
+
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+
+        for (int p = 0; p < 6; ++p)
+        {
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeA[p], cx), _mm_mul_ps(planeB[p], cy)),
+                                     _mm_add_ps(_mm_mul_ps(planeC[p], cz), planeD[p]));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absA[p], ex), _mm_mul_ps(absB[p], ey)), _mm_mul_ps(absC[p], ez));
+
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(dist, radius), zero));
+
+            // all 4 boxes rejected
+            if (!_mm_movemask_ps(inside))
+                break;
+        }
+
+        int mask = _mm_movemask_ps(inside);
+
+        for (int j = 0; j < 4; ++j)
+            visible[i + j] = (mask >> j) & 1;
+    }
+#endif
+
+    for (; i < count; ++i)
+        visible[i] = BoxInFrustum(boxes, indices[i]);
+}
+
+// classify an axis aligned box, testing only the corners nearest/farthest along each plane normal
+FrustumTestResult Frustum::TestBox(const Math::Vector3f &mins, const Math::Vector3f &maxs) const
+{
+    FrustumTestResult result = BoxInside;
+
+    for (int i = 0; i < 6; ++i)
+    {
+        const Plane &p = m_planes[i];
+
+        // corner farthest along the plane normal - if it's behind the plane, the whole box is
+        float farDist = p.A * (p.A > 0 ? maxs.m_x : mins.m_x) +
+                        p.B * (p.B > 0 ? maxs.m_y : mins.m_y) +
+                        p.C * (p.C > 0 ? maxs.m_z : mins.m_z) + p.D;
+
+        if (farDist <= 0)
+            return BoxOutside;
+
+        // nearest corner behind the plane - box straddles it
+        float nearDist = p.A * (p.A > 0 ? mins.m_x : maxs.m_x) +
+                         p.B * (p.B > 0 ? mins.m_y : maxs.m_y) +
+                         p.C * (p.C > 0 ? mins.m_z : maxs.m_z) + p.D;
+
+        if (nearDist <= 0)
+            result = BoxIntersects;
+    }
+
+    return result;
+}
+
 // extract a plane from a given matrix and row id
 void Frustum::ExtractPlane(Plane &plane, const Math::Matrix4f &mvpMatrix, int row)
 {
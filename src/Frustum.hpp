@@ -1,8 +1,8 @@
 #ifndef FRUSTUM_INCLUDED
 #define FRUSTUM_INCLUDED
 
-#include "renderer/OpenGL.hpp"
 #include "Math.hpp"
+#include <vector>
 
 /*
  * View frustum 
@@ -13,11 +13,42 @@ struct Plane
     float A, B, C, D;
 };
 
+// result of an axis aligned box test
+enum FrustumTestResult
+{
+    BoxOutside,
+    BoxIntersects,
+    BoxInside
+};
+
+// axis aligned boxes in center/extent form, stored as structure of arrays for batched culling
+struct BoxListSoA
+{
+    void Resize(size_t size)
+    {
+        centerX.resize(size); centerY.resize(size); centerZ.resize(size);
+        extentX.resize(size); extentY.resize(size); extentZ.resize(size);
+    }
+
+    void Set(size_t idx, const Math::Vector3f &mins, const Math::Vector3f &maxs)
+    {
+        centerX[idx] = (mins.m_x + maxs.m_x) * 0.5f; extentX[idx] = (maxs.m_x - mins.m_x) * 0.5f;
+        centerY[idx] = (mins.m_y + maxs.m_y) * 0.5f; extentY[idx] = (maxs.m_y - mins.m_y) * 0.5f;
+        centerZ[idx] = (mins.m_z + maxs.m_z) * 0.5f; extentZ[idx] = (maxs.m_z - mins.m_z) * 0.5f;
+    }
+
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+};
+
 class Frustum
 {
 public:
-    void OnRender();
-    bool BoxInFrustum(const Math::Vector3f *vertices);
+    void Update(const Math::Matrix4f &mvpMatrix);
+    bool BoxInFrustum(const Math::Vector3f *vertices) const;   // scalar reference: 8 box corners
+    bool BoxInFrustum(const BoxListSoA &boxes, int idx) const;
+    void BoxesInFrustum(const BoxListSoA &boxes, const int *indices, int count, unsigned char *visible) const;
+    FrustumTestResult TestBox(const Math::Vector3f &mins, const Math::Vector3f &maxs) const;
 
 private:
     void ExtractPlane(Plane &plane, const Math::Matrix4f &mvpMatrix, int row);
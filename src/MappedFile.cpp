@@ -0,0 +1,109 @@
+#include "MappedFile.hpp"
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : m_data(NULL), m_size(0)
+#ifdef _WIN32
+                           , m_fileHandle(INVALID_HANDLE_VALUE), m_mappingHandle(NULL)
+#else
+                           , m_fileDescriptor(-1)
+#endif
+{
+}
+
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+
+bool MappedFile::Open(const std::string &filename)
+{
+    Close();
+
+#ifdef _WIN32
+    m_fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (m_fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_fileHandle, &fileSize) || fileSize.QuadPart == 0)
+    {
+        Close();
+        return false;
+    }
+
+    m_mappingHandle = CreateFileMappingA(m_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (m_mappingHandle == NULL)
+    {
+        Close();
+        return false;
+    }
+
+    m_data = (const unsigned char *)MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    m_size = (size_t)fileSize.QuadPart;
+#else
+    m_fileDescriptor = open(filename.c_str(), O_RDONLY);
+
+    if (m_fileDescriptor < 0)
+        return false;
+
+    struct stat fileStat;
+    if (fstat(m_fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        Close();
+        return false;
+    }
+
+    void *mapping = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+
+    m_data = (mapping != MAP_FAILED) ? (const unsigned char *)mapping : NULL;
+    m_size = (size_t)fileStat.st_size;
+#endif
+
+    if (m_data == NULL)
+    {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if (m_data)
+        UnmapViewOfFile(m_data);
+
+    if (m_mappingHandle)
+        CloseHandle(m_mappingHandle);
+
+    if (m_fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(m_fileHandle);
+
+    m_mappingHandle = NULL;
+    m_fileHandle    = INVALID_HANDLE_VALUE;
+#else
+    if (m_data)
+        munmap((void *)m_data, m_size);
+
+    if (m_fileDescriptor >= 0)
+        close(m_fileDescriptor);
+
+    m_fileDescriptor = -1;
+#endif
+
+    m_data = NULL;
+    m_size = 0;
+}
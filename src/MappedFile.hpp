@@ -0,0 +1,38 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <string>
+
+/*
+ * Read-only memory mapped file
+ */
+
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool Open(const std::string &filename);
+    void Close();
+
+    bool IsOpen() const { return m_data != NULL; }
+    const unsigned char *Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    const unsigned char *m_data;
+    size_t m_size;
+
+#ifdef _WIN32
+    void *m_fileHandle;
+    void *m_mappingHandle;
+#else
+    int   m_fileDescriptor;
+#endif
+};
+
+#endif
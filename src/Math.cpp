@@ -1,4 +1,5 @@
 #include "Math.hpp"
+#include <string.h>
 
 namespace Math
 {
@@ -225,14 +226,14 @@ namespace Math
 
     float QuickInverseSqrt( float number )
     {
-        long i;
+        int i;  // must be 32 bits (long is 64 bits on LP64 platforms)
         float x2, y;
 
         x2 = number * 0.5F;
         y  = number;
-        i  = * ( long * ) &y;
+        memcpy( &i, &y, sizeof(float) );
         i  = 0x5f3759df - ( i >> 1 );
-        y  = * ( float * ) &i;
+        memcpy( &y, &i, sizeof(float) );
         y  = y * ( 1.5f - ( x2 * y * y ) );   // 1st iteration
         y  = y * ( 1.5f - ( x2 * y * y ) );   // 2nd iteration
 
@@ -0,0 +1,108 @@
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+
+ThreadPool* ThreadPool::GetInstance()
+{
+    static ThreadPool instance;
+    return &instance;
+}
+
+
+ThreadPool::ThreadPool() : m_stopping(false)
+{
+#if TRACE_ENABLED
+    // workers record zones until they're joined - constructing the trace first makes it outlive the pool
+    Trace::GetInstance();
+#endif
+
+    int numWorkers = std::max(1, (int)std::thread::hardware_concurrency());
+
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        m_workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+    }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_jobsMutex);
+        m_stopping = true;
+    }
+
+    m_jobsCondition.notify_all();
+
+    for (auto &w : m_workers)
+        w.join();
+}
+
+
+std::future<void> ThreadPool::Enqueue(const std::function<void()> &job)
+{
+    std::packaged_task<void()> task(job);
+    std::future<void> result = task.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(m_jobsMutex);
+        m_jobs.push(std::move(task));
+    }
+
+    m_jobsCondition.notify_one();
+
+    return result;
+}
+
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)> &func)
+{
+    if (count <= 0)
+        return;
+
+    // a few chunks per worker to even out uneven job costs
+    int numChunks = std::min(count, NumWorkers() * 4);
+    int chunkSize = (count + numChunks - 1) / numChunks;
+
+    std::vector< std::future<void> > chunks;
+    chunks.reserve(numChunks);
+
+    for (int start = 0; start < count; start += chunkSize)
+    {
+        int end = std::min(start + chunkSize, count);
+
+        chunks.push_back(Enqueue([&func, start, end]()
+        {
+            for (int i = start; i < end; ++i)
+                func(i);
+        }));
+    }
+
+    for (auto &c : chunks)
+        c.get();
+}
+
+
+void ThreadPool::WorkerLoop()
+{
+    TRACE_THREAD_NAME("worker");
+
+    while (true)
+    {
+        std::packaged_task<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(m_jobsMutex);
+            m_jobsCondition.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+
+            if (m_stopping && m_jobs.empty())
+                return;
+
+            task = std::move(m_jobs.front());
+            m_jobs.pop();
+        }
+
+        TRACE_SCOPE("ThreadPool job");
+        task();
+    }
+}
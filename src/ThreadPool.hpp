@@ -0,0 +1,43 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/*
+ * Worker thread pool for CPU-only jobs (no OpenGL calls allowed in jobs!)
+ */
+
+class ThreadPool
+{
+public:
+    static ThreadPool* GetInstance();
+
+    // queue a job - returned future signals its completion
+    std::future<void> Enqueue(const std::function<void()> &job);
+
+    // run func(i) for each i in [0, count) on the workers and wait for all of them to finish.
+    // Must not be called from inside a job (waiting workers could starve the pool).
+    void ParallelFor(int count, const std::function<void(int)> &func);
+
+    int NumWorkers() const { return (int)m_workers.size(); }
+
+private:
+    ThreadPool();
+    ~ThreadPool();
+
+    void WorkerLoop();
+
+    std::vector<std::thread> m_workers;
+    std::queue< std::packaged_task<void()> > m_jobs;
+    std::mutex              m_jobsMutex;
+    std::condition_variable m_jobsCondition;
+    bool                    m_stopping;
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef TIMER_HPP
+#define TIMER_HPP
+
+#include <chrono>
+
+/*
+ * High resolution stopwatch
+ */
+
+class Timer
+{
+public:
+    Timer() : m_start(std::chrono::high_resolution_clock::now())
+    {
+    }
+
+    void Reset() { m_start = std::chrono::high_resolution_clock::now(); }
+
+    // elapsed time since construction/last reset in milliseconds
+    double ElapsedMs() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_start).count();
+    }
+
+private:
+    std::chrono::high_resolution_clock::time_point m_start;
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include "Trace.hpp"
+
+#if TRACE_ENABLED
+
+#include <fstream>
+#include <iomanip>
+
+Trace* Trace::GetInstance()
+{
+    static Trace instance;
+    return &instance;
+}
+
+
+void Trace::SetThreadName(const char *name)
+{
+    ThreadRing()->threadName = name;
+}
+
+
+void Trace::AddZone(const char *name, long long start, long long end)
+{
+    TraceRing *ring = ThreadRing();
+
+    // only the owning thread writes, publishing the zone by advancing writeIdx
+    unsigned int idx = ring->writeIdx.load(std::memory_order_relaxed);
+
+    TraceZone &zone = ring->zones[idx & (s_ringSize - 1)];
+    zone.name  = name;
+    zone.start = start;
+    zone.end   = end;
+
+    ring->writeIdx.store(idx + 1, std::memory_order_release);
+}
+
+
+bool Trace::WriteJson(const std::string &filename)
+{
+    std::ofstream jsonFile(filename, std::ios::out | std::ios::trunc);
+
+    if (!jsonFile.is_open())
+        return false;
+
+    // microseconds with nanosecond precision
+    jsonFile << std::fixed << std::setprecision(3);
+    jsonFile << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    std::vector<TraceZone> snapshot;
+    bool first = true;
+
+    for (const auto &ring : m_rings)
+    {
+        if (ring->threadName)
+        {
+            jsonFile << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << ring->threadId
+                     << ",\"args\":{\"name\":\"" << ring->threadName << "\"}}";
+            first = false;
+        }
+
+        unsigned int end   = ring->writeIdx.load(std::memory_order_acquire);
+        unsigned int begin = end > s_ringSize ? end - s_ringSize : 0;
+
+        // the owning thread keeps writing - copy the ring out first, then drop the zones it
+        // overwrote meanwhile (zone i is reused by i + s_ringSize, written before writeIdx passes it)
+        snapshot.resize(end - begin);
+
+        for (unsigned int i = begin; i != end; ++i)
+            snapshot[i - begin] = ring->zones[i & (s_ringSize - 1)];
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        unsigned int writeIdx = ring->writeIdx.load(std::memory_order_relaxed);
+
+        for (unsigned int i = begin; i != end; ++i)
+        {
+            if (writeIdx - i >= s_ringSize)
+                continue;
+
+            const TraceZone &zone = snapshot[i - begin];
+
+            jsonFile << (first ? "" : ",\n") << "{\"name\":\"" << zone.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << ring->threadId
+                     << ",\"ts\":" << zone.start / 1000.0 << ",\"dur\":" << (zone.end - zone.start) / 1000.0 << "}";
+            first = false;
+        }
+    }
+
+    jsonFile << "\n]}\n";
+
+    return true;
+}
+
+
+Trace::TraceRing *Trace::ThreadRing()
+{
+    static thread_local TraceRing *threadRing = NULL;
+
+    if (!threadRing)
+    {
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+
+        m_rings.push_back(std::unique_ptr<TraceRing>(new TraceRing));
+        threadRing = m_rings.back().get();
+        threadRing->writeIdx   = 0;
+        threadRing->threadId   = (int)m_rings.size();
+        threadRing->threadName = NULL;
+    }
+
+    return threadRing;
+}
+
+#endif
\ No newline at end of file
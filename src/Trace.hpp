@@ -0,0 +1,104 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+// set to 0 to compile all trace zones out
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+#if TRACE_ENABLED
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Lightweight zone tracer writing Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev).
+ * Each thread records into its own ring buffer (single writer, no locks), so only the most
+ * recent s_ringSize zones per thread are kept. Zone names must be string literals.
+ */
+
+class Trace
+{
+public:
+    static const unsigned int s_ringSize = 1 << 16;   // zones kept per thread (power of 2)
+
+    static Trace* GetInstance();
+
+    void SetThreadName(const char *name);
+    void AddZone(const char *name, long long start, long long end);
+
+    // dump the contents of all ring buffers; zones recorded while writing may be dropped
+    bool WriteJson(const std::string &filename);
+
+    // nanoseconds since tracer start
+    long long Now() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - m_start).count();
+    }
+
+private:
+    struct TraceZone
+    {
+        const char *name;
+        long long   start;
+        long long   end;
+    };
+
+    struct TraceRing
+    {
+        std::atomic<unsigned int> writeIdx;
+        int         threadId;
+        const char *threadName;
+        TraceZone   zones[s_ringSize];
+    };
+
+    Trace() : m_start(std::chrono::high_resolution_clock::now())
+    {
+    }
+
+    TraceRing *ThreadRing();
+
+    std::chrono::high_resolution_clock::time_point m_start;
+    std::vector< std::unique_ptr<TraceRing> > m_rings; // one per thread, kept until exit
+    std::mutex m_ringsMutex;                            // guards ring registration only
+};
+
+
+// records a zone spanning the current scope
+class TraceScope
+{
+public:
+    TraceScope(const char *name) : m_name(name), m_start(Trace::GetInstance()->Now())
+    {
+    }
+
+    ~TraceScope()
+    {
+        Trace::GetInstance()->AddZone(m_name, m_start, Trace::GetInstance()->Now());
+    }
+
+private:
+    const char *m_name;
+    long long   m_start;
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#define TRACE_SCOPE(name)        TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_THREAD_NAME(name)  Trace::GetInstance()->SetThreadName(name)
+#define TRACE_WRITE(filename)    Trace::GetInstance()->WriteJson(filename)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_THREAD_NAME(name)
+#define TRACE_WRITE(filename)    false
+
+#endif
+
+#endif
\ No newline at end of file
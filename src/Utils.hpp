@@ -1,6 +1,8 @@
 #ifndef UTILS_HPP
 #define UTILS_HPP
 
+#include <cstddef>
+
 #ifdef _DEBUG
 #include <sstream>
 #define LOG_MESSAGE(msg) { \
@@ -25,4 +27,19 @@
 void LogError(const char *msg);
 void ClearWindow(float r, float g, float b);
 void DrawRectangle(float x, float y, float w, float h, float r, float g, float b);
+
+// 64-bit FNV-1a
+inline unsigned long long HashBytes(const unsigned char *data, size_t size)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
 #endif
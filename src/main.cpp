@@ -4,6 +4,10 @@
 #include "renderer/OculusVR.hpp"
 #include "renderer/ShaderManager.hpp"
 #include "renderer/CameraDirector.hpp"
+#include "renderer/FrameProfiler.hpp"
+#include "renderer/TextureManager.hpp"
+#include "renderer/UploadRing.hpp"
+#include "Trace.hpp"
 
 // for simplicity, let's use globals
 RenderContext  g_renderContext;
@@ -36,10 +40,16 @@ int main(int argc, char **argv)
 
         if (!strncmp(argv[i], "-h", 2) && (i + 1 < argc))
             screenHeight = atoi(argv[i + 1]);
+
+        // block compressed world textures
+        if (!strcmp(argv[i], "-bc"))
+            TextureManager::GetInstance()->SetCompression(true);
     }
 
     ovrSizei windowSize;
 
+    TRACE_THREAD_NAME("main");
+
     if (vrMode)
     {
         if (!g_oculusVR.InitVR())
@@ -75,6 +85,8 @@ int main(int argc, char **argv)
     }
 
     ShaderManager::GetInstance()->LoadShaders();
+    FrameProfiler::GetInstance()->Init();
+    UploadRing::GetInstance()->Init();
 
     if (vrMode)
     {
@@ -112,10 +124,15 @@ int main(int argc, char **argv)
 
     while (g_application.Running())
     {
+        TRACE_SCOPE("Frame");
+
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // handle key presses
-        processEvents();
+        {
+            TRACE_SCOPE("processEvents");
+            processEvents();
+        }
 
         if (g_application.VREnabled())
         {
@@ -127,8 +144,12 @@ int main(int argc, char **argv)
 
             Math::Vector3f camPos = g_cameraDirector.GetActiveCamera()->Position();
 
+            static const char *eyeZoneNames[ovrEye_Count] = { "OnEyeRender (left)", "OnEyeRender (right)" };
+
             for (int eyeIndex = 0; eyeIndex < ovrEye_Count; eyeIndex++)
             {
+                TRACE_SCOPE(eyeZoneNames[eyeIndex]);
+
                 OVR::Matrix4f OVRMVP = g_oculusVR.OnEyeRender(eyeIndex);
                 OVR::Matrix4f MVPMatrix = (OVRMVP * OVR::Matrix4f(OVR::Quatf(OVR::Vector3f(1.0, 0.0, 0.0), -PIdiv2)) // rotate 90 degrees by X axis (BSP world is flipped)
                                                   * OVR::Matrix4f::Translation(-OVR::Vector3f(camPos.m_x, camPos.m_y, camPos.m_z))).Transposed();
@@ -147,7 +168,10 @@ int main(int argc, char **argv)
                 g_oculusVR.OnEyeRenderFinish(eyeIndex);
             }
 
-            g_oculusVR.SubmitFrame();
+            {
+                TRACE_SCOPE("SubmitFrame");
+                g_oculusVR.SubmitFrame();
+            }
 
             BlitOVRMirror(windowSize, camPos);
         }
@@ -162,11 +186,19 @@ int main(int argc, char **argv)
             g_application.OnRender();
         }
 
-        SDL_GL_SwapWindow(g_renderContext.window);
+        {
+            TRACE_SCOPE("SwapWindow");
+            ProfileScope profile(ProfileSwap);
+            SDL_GL_SwapWindow(g_renderContext.window);
+        }
+        FrameProfiler::GetInstance()->EndFrame();
+        UploadRing::GetInstance()->EndFrame();
         last = now;
     }
 
     g_application.OnTerminate();
+    FrameProfiler::GetInstance()->Destroy();
+    UploadRing::GetInstance()->Destroy();
     g_oculusVR.DestroyVR();
     g_renderContext.Destroy();
     SDL_Quit();
@@ -178,6 +210,7 @@ int main(int argc, char **argv)
 // helper function for various Oculus Rift mirror render modes
 void BlitOVRMirror(ovrSizei windowSize, const Math::Vector3f &camPos)
 {
+    TRACE_SCOPE("BlitOVRMirror");
     Application::VRMirrorMode mirrorMode = g_application.CurrMirrorMode();
 
     // Standard mirror blit (both eyes, distorted)
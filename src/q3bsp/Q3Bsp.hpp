@@ -163,35 +163,6 @@ struct Q3BspVertexLump
     vec2f texcoord[2];
     vec3f normal;
     unsigned char color[4];
-
-    Q3BspVertexLump operator+(const Q3BspVertexLump & rhs) const
-    {
-        Q3BspVertexLump result;
-        result.position.x = position.x + rhs.position.x;
-        result.position.y = position.y + rhs.position.y;
-        result.position.z = position.z + rhs.position.z;
-
-        result.texcoord[0].x = texcoord[0].x + rhs.texcoord[0].x;
-        result.texcoord[0].y = texcoord[0].y + rhs.texcoord[0].y;
-        result.texcoord[1].x = texcoord[1].x + rhs.texcoord[1].x;
-        result.texcoord[1].y = texcoord[1].y + rhs.texcoord[1].y;
-
-        return result;
-    }
-
-    Q3BspVertexLump operator*(const float rhs) const
-    {
-        Q3BspVertexLump result;
-        result.position.x = position.x * rhs;
-        result.position.y = position.y * rhs;
-        result.position.z = position.z * rhs;
-        result.texcoord[0].x = texcoord[0].x * rhs;
-        result.texcoord[0].y = texcoord[0].y * rhs;
-        result.texcoord[1].x = texcoord[1].x * rhs;
-        result.texcoord[1].y = texcoord[1].y * rhs;
-
-        return result;
-    }
 };
 
 
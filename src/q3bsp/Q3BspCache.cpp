@@ -0,0 +1,127 @@
+#include "q3bsp/Q3BspCache.hpp"
+#include "Utils.hpp"
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+const int Q3BspCache::s_version = 9;
+
+static const char s_cacheMagic[4] = { 'B', 'S', 'P', 'C' };
+
+
+bool Q3BspCache::Open(const std::string &filename, unsigned long long bspHash, int tesselationLevel, float lightmapGamma)
+{
+    if (!m_file.Open(filename) || m_file.Size() < sizeof(Q3BspCacheHeader))
+        return false;
+
+    memcpy(&m_header, m_file.Data(), sizeof(Q3BspCacheHeader));
+
+    // stale or foreign cache - needs rebuilding
+    if (memcmp(m_header.magic, s_cacheMagic, 4) || m_header.version != s_version || m_header.bspHash != bspHash ||
+        m_header.tesselationLevel != tesselationLevel || m_header.lightmapGamma != lightmapGamma)
+    {
+        m_file.Close();
+        return false;
+    }
+
+    // file could have been truncated while being written
+    for (int i = 0; i < NumCacheLumps; ++i)
+    {
+        const Q3BspDirEntry &entry = m_header.direntries[i];
+
+        if (entry.offset < 0 || entry.length < 0 || (entry.offset % sizeof(int)) != 0 ||
+            (size_t)entry.offset + (size_t)entry.length > m_file.Size())
+        {
+            m_file.Close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+void Q3BspCache::Close()
+{
+    m_file.Close();
+}
+
+
+// write lump data and return its directory entry
+template<class T>
+static Q3BspDirEntry WriteLump(std::ofstream &fstream, const std::vector<T> &data)
+{
+    Q3BspDirEntry entry;
+    entry.offset = (int)fstream.tellp();
+    entry.length = (int)(data.size() * sizeof(T));
+
+    if (!data.empty())
+        fstream.write((const char *)&data[0], entry.length);
+
+    return entry;
+}
+
+
+bool Q3BspCache::Write(const std::string &filename,
+                       const Q3BspCacheHeader &header,
+                       const std::vector<Q3LeafRenderable>  &leaves,
+                       const std::vector<Q3BspVertexLump>   &vertices,
+                       const std::vector<unsigned int>      &indices,
+                       const std::vector<Q3BspLightMapLump> &lightmaps)
+{
+    // a crash while writing must not leave a file with a valid header behind
+    std::string tmpFilename = filename + ".tmp";
+    std::ofstream cacheFile(tmpFilename, std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (!cacheFile.is_open())
+        return false;
+
+    Q3BspCacheHeader cacheHeader = header;
+    memcpy(cacheHeader.magic, s_cacheMagic, 4);
+    cacheHeader.version = s_version;
+
+    // reserve space for the header - it's rewritten once lump offsets are known
+    cacheFile.write((const char *)&cacheHeader, sizeof(Q3BspCacheHeader));
+
+    cacheHeader.direntries[CacheLeaves]    = WriteLump(cacheFile, leaves);
+    cacheHeader.direntries[CacheVertices]  = WriteLump(cacheFile, vertices);
+    cacheHeader.direntries[CacheIndices]   = WriteLump(cacheFile, indices);
+    cacheHeader.direntries[CacheLightmaps] = WriteLump(cacheFile, lightmaps);
+
+    cacheFile.seekp(0, std::ios_base::beg);
+    cacheFile.write((const char *)&cacheHeader, sizeof(Q3BspCacheHeader));
+    cacheFile.close();
+
+    if (!cacheFile.good())
+    {
+        remove(tmpFilename.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    if (!MoveFileExA(tmpFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING))
+#else
+    if (rename(tmpFilename.c_str(), filename.c_str()) != 0)
+#endif
+    {
+        remove(tmpFilename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+std::string Q3BspCache::CacheFilename(const std::string &bspFilename)
+{
+    return bspFilename + "c";
+}
+
+
+unsigned long long Q3BspCache::Hash(const unsigned char *data, size_t size)
+{
+    return HashBytes(data, size);
+}
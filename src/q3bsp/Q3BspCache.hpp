@@ -0,0 +1,75 @@
+#ifndef Q3BSPCACHE_INCLUDED
+#define Q3BSPCACHE_INCLUDED
+
+#include "q3bsp/Q3Bsp.hpp"
+#include "q3bsp/Q3BspRenderHelpers.hpp"
+#include "MappedFile.hpp"
+#include <string>
+
+/*
+ *  Render-ready map cache (.bspc) stored next to the .bsp file. Holds data baked during
+ *  Q3BspMap::Init() so that subsequent runs can skip CPU preprocessing. The file is memory mapped
+ *  and all arrays are accessed in place.
+ */
+
+// lumps stored in the cache file
+enum Q3BspCacheLumpTypes
+{
+    CacheLeaves = 0,   // Q3LeafRenderable
+    CacheVertices,     // Q3BspVertexLump  (map vertex buffer: bsp vertices + tesselated patches)
+    CacheIndices,      // unsigned int     (map index buffer: face mesh vertices + patch strips)
+    CacheLightmaps,    // Q3BspLightMapLump (gamma corrected)
+    NumCacheLumps
+};
+
+
+struct Q3BspCacheHeader
+{
+    char               magic[4];
+    int                version;
+    unsigned long long bspHash;           // hash of the source .bsp file
+    int                tesselationLevel;  // Q3BspMap::s_tesselationLevel used for baking
+    float              lightmapGamma;     // gamma applied to cached lightmaps
+    Q3BspDirEntry      direntries[NumCacheLumps];
+};
+
+
+class Q3BspCache
+{
+public:
+    static const int s_version;
+
+    // map the cache file and check if it matches the bsp and current bake settings
+    bool Open(const std::string &filename, unsigned long long bspHash, int tesselationLevel, float lightmapGamma);
+    // unmap the cache file - required before it can be rewritten
+    void Close();
+
+    // written to a temporary file first and moved over the old cache once complete
+    static bool Write(const std::string &filename,
+                      const Q3BspCacheHeader &header,
+                      const std::vector<Q3LeafRenderable>  &leaves,
+                      const std::vector<Q3BspVertexLump>   &vertices,
+                      const std::vector<unsigned int>      &indices,
+                      const std::vector<Q3BspLightMapLump> &lightmaps);
+
+    static std::string CacheFilename(const std::string &bspFilename);
+    static unsigned long long Hash(const unsigned char *data, size_t size);
+
+    template<class T>
+    const T *Lump(Q3BspCacheLumpTypes lType) const
+    {
+        return (const T *)(m_file.Data() + m_header.direntries[lType].offset);
+    }
+
+    template<class T>
+    int LumpSize(Q3BspCacheLumpTypes lType) const
+    {
+        return m_header.direntries[lType].length / sizeof(T);
+    }
+
+private:
+    MappedFile       m_file;
+    Q3BspCacheHeader m_header;
+};
+
+#endif
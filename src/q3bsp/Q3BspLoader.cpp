@@ -1,14 +1,31 @@
 #include "q3bsp/Q3BspLoader.hpp"
+#include "Utils.hpp"
+#include <cstring>
 #include <fstream>
 
-Q3BspMap *Q3BspLoader::Load(const std::string &filename)
+bool Q3BspLoader::Load(const std::string &filename, Q3BspWorld *q3map, bool memoryMapped)
 {
+    if (memoryMapped)
+    {
+        MappedFile *mappedFile = new MappedFile;
+
+        if (mappedFile->Open(filename) && LoadMapped(mappedFile, q3map))
+        {
+            q3map->m_filename = filename;
+            return true;
+        }
+
+        // mapping failed or the file didn't pass validation - read it the regular way
+        LOG_MESSAGE("[Q3BspLoader] Memory mapping failed, using stream loading: " << filename);
+        delete mappedFile;
+    }
+
     std::ifstream bspFile;    
     bspFile.open(filename, std::ios::in | std::ios::binary );
     
     if(!bspFile.is_open())
     {
-        return NULL;
+        return false;
     }
 
     // bsp header
@@ -20,13 +37,12 @@ Q3BspMap *Q3BspLoader::Load(const std::string &filename)
 
     if(!validQ3Bsp)
     {
-        return NULL;
+        return false;
     }
 
     // header is valid - load the rest of the map
-    Q3BspMap *q3map = new Q3BspMap;
-    
-    q3map->header = bspHeader;
+    q3map->header     = bspHeader;
+    q3map->m_filename = filename;
 
     // entities lump
     LoadEntitiesLump( q3map, bspFile );
@@ -51,7 +67,110 @@ Q3BspMap *Q3BspLoader::Load(const std::string &filename)
 
     bspFile.close();
 
-    return q3map;
+    return true;
+}
+
+
+// zero-copy loading: render-critical lumps are accessed directly from the mapped file
+bool Q3BspLoader::LoadMapped(MappedFile *file, Q3BspWorld *q3map)
+{
+    if (file->Size() < sizeof(Q3BspHeader))
+        return false;
+
+    Q3BspHeader bspHeader;
+    memcpy(&bspHeader, file->Data(), sizeof(Q3BspHeader));
+
+    //validate the header
+    bool validQ3Bsp = !strncmp(bspHeader.magic, "IBSP", 4) && (bspHeader.version == 0x2e);
+
+    if (!validQ3Bsp || !ValidateMappedLumps(*file, bspHeader))
+    {
+        return false;
+    }
+
+    q3map->header       = bspHeader;
+    q3map->m_mappedFile = file;
+
+    // entities lump
+    q3map->entities.size = bspHeader.direntries[Entities].length;
+    q3map->entities.ents = new char[q3map->entities.size];
+    memcpy(q3map->entities.ents, file->Data() + bspHeader.direntries[Entities].offset, q3map->entities.size);
+
+    // mapped lumps
+    MapLump( q3map, Planes,       q3map->planes,       *file );
+    MapLump( q3map, Nodes,        q3map->nodes,        *file );
+    MapLump( q3map, Leafs,        q3map->leaves,       *file );
+    MapLump( q3map, Vertices,     q3map->vertices,     *file );
+    MapLump( q3map, MeshVerts,    q3map->meshVertices, *file );
+    MapLump( q3map, Faces,        q3map->faces,        *file );
+    // remaining lumps are small or get modified in Init() - keep a private copy
+    CopyLump( q3map, Textures,    q3map->textures,     *file );
+    CopyLump( q3map, LeafFaces,   q3map->leafFaces,    *file );
+    CopyLump( q3map, LeafBrushes, q3map->leafBrushes,  *file );
+    CopyLump( q3map, Models,      q3map->models,       *file );
+    CopyLump( q3map, Brushes,     q3map->brushes,      *file );
+    CopyLump( q3map, BrushSides,  q3map->brushSides,   *file );
+    CopyLump( q3map, Effects,     q3map->effects,      *file );
+    CopyLump( q3map, Lightmaps,   q3map->lightMaps,    *file );
+    CopyLump( q3map, LightVols,   q3map->lightVols,    *file );
+
+    // vis data lump
+    const unsigned char *visLump = file->Data() + bspHeader.direntries[VisData].offset;
+
+    if (bspHeader.direntries[VisData].length >= (int)(2 * sizeof(int)))
+    {
+        memcpy(&q3map->visData.n_vecs,  visLump, sizeof(int));
+        memcpy(&q3map->visData.sz_vecs, visLump + sizeof(int), sizeof(int));
+        q3map->visData.vecs = const_cast<unsigned char *>(visLump + 2 * sizeof(int));
+    }
+    else
+    {
+        q3map->visData.n_vecs  = 0;
+        q3map->visData.sz_vecs = 0;
+        q3map->visData.vecs    = NULL;
+    }
+
+    return true;
+}
+
+
+// make sure every lump can be safely accessed in place
+bool Q3BspLoader::ValidateMappedLumps(const MappedFile &file, const Q3BspHeader &hdr) const
+{
+    for (int i = Entities; i <= VisData; ++i)
+    {
+        if (!LumpFitsFile(file, hdr.direntries[i]))
+            return false;
+    }
+
+    const Q3BspDirEntry &visEntry = hdr.direntries[VisData];
+
+    if (visEntry.length >= (int)(2 * sizeof(int)))
+    {
+        const int *visHeader = (const int *)(file.Data() + visEntry.offset);
+
+        if (visHeader[0] < 0 || visHeader[1] < 0)
+            return false;
+
+        if ((long long)visHeader[0] * visHeader[1] > (long long)visEntry.length - (long long)(2 * sizeof(int)))
+            return false;
+    }
+
+    return true;
+}
+
+
+// check if lump lies within the file and is properly aligned for direct access
+bool Q3BspLoader::LumpFitsFile(const MappedFile &file, const Q3BspDirEntry &entry) const
+{
+    if (entry.offset < 0 || entry.length < 0)
+        return false;
+
+    if ((size_t)entry.offset + (size_t)entry.length > file.Size())
+        return false;
+
+    // mapping base is page aligned, so only the offset needs checking
+    return (entry.offset % sizeof(int)) == 0;
 }
 
 
@@ -61,7 +180,7 @@ void Q3BspLoader::LoadBspHeader(Q3BspHeader &hdr, std::ifstream &fstream)
 }
 
 
-void Q3BspLoader::LoadEntitiesLump(Q3BspMap *map, std::ifstream &fstream)
+void Q3BspLoader::LoadEntitiesLump(Q3BspWorld *map, std::ifstream &fstream)
 {
     map->entities.size = map->header.direntries[Entities].length;	
     map->entities.ents = new char[map->entities.size];
@@ -71,7 +190,7 @@ void Q3BspLoader::LoadEntitiesLump(Q3BspMap *map, std::ifstream &fstream)
 }
 
 
-void Q3BspLoader::LoadVisDataLump(Q3BspMap *map, std::ifstream &fstream)
+void Q3BspLoader::LoadVisDataLump(Q3BspWorld *map, std::ifstream &fstream)
 {
     fstream.seekg( map->header.direntries[VisData].offset, std::ios_base::beg );
 
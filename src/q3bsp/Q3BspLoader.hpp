@@ -1,7 +1,9 @@
 #ifndef Q3BSPLOADER_INCLUDED
 #define Q3BSPLOADER_INCLUDED
 
-#include "q3bsp/Q3BspMap.hpp"
+#include "q3bsp/Q3BspWorld.hpp"
+#include "MappedFile.hpp"
+#include <fstream>
 
 /*
  *  Loading class for Q3 bsp
@@ -10,21 +12,37 @@
 class Q3BspLoader
 {
 public:
-    Q3BspMap *Load(const std::string &filename);
+    // load bsp data into the provided map (renderable Q3BspMap or headless Q3BspWorld)
+    // memory mapped loading falls back to regular stream reading if the file fails validation
+    bool Load(const std::string &filename, Q3BspWorld *q3map, bool memoryMapped = true);
 
 private:
+    bool LoadMapped(MappedFile *file, Q3BspWorld *q3map);
+    bool ValidateMappedLumps(const MappedFile &file, const Q3BspHeader &hdr) const;
+
     void LoadBspHeader(Q3BspHeader &hdr, std::ifstream &fstream);
-    void LoadEntitiesLump(Q3BspMap *map, std::ifstream &fstream);
-    void LoadVisDataLump(Q3BspMap  *map, std::ifstream &fstream);
+    void LoadEntitiesLump(Q3BspWorld *map, std::ifstream &fstream);
+    void LoadVisDataLump(Q3BspWorld *map, std::ifstream &fstream);
+
+    template<class T>
+    void LoadLump(Q3BspWorld *map, LumpTypes lType, std::vector<T> &container, std::ifstream &fstream);
+
+    template<class T>
+    void LoadLump(Q3BspWorld *map, LumpTypes lType, Q3BspLumpSpan<T> &span, std::ifstream &fstream);
+
+    template<class T>
+    void CopyLump(Q3BspWorld *map, LumpTypes lType, std::vector<T> &container, const MappedFile &file);
 
     template<class T>
-    void LoadLump(Q3BspMap *map, LumpTypes lType, std::vector<T> &container, std::ifstream &fstream);
+    void MapLump(Q3BspWorld *map, LumpTypes lType, Q3BspLumpSpan<T> &span, const MappedFile &file);
+
+    bool LumpFitsFile(const MappedFile &file, const Q3BspDirEntry &entry) const;
 };
 
 
 // common loader for generic bsp lumps
 template<class T>
-void Q3BspLoader::LoadLump(Q3BspMap *map, LumpTypes lType, std::vector<T> &container, std::ifstream &fstream)
+void Q3BspLoader::LoadLump(Q3BspWorld *map, LumpTypes lType, std::vector<T> &container, std::ifstream &fstream)
 {
     int numElements = map->header.direntries[lType].length / sizeof(T);
     fstream.seekg( map->header.direntries[lType].offset, std::ios_base::beg );
@@ -40,4 +58,37 @@ void Q3BspLoader::LoadLump(Q3BspMap *map, LumpTypes lType, std::vector<T> &conta
     }
 }
 
+
+// stream loading of a lump exposed as a span - span takes over the vector storage
+template<class T>
+void Q3BspLoader::LoadLump(Q3BspWorld *map, LumpTypes lType, Q3BspLumpSpan<T> &span, std::ifstream &fstream)
+{
+    std::vector<T> container;
+    LoadLump(map, lType, container, fstream);
+
+    span.SetStorage(container);
+}
+
+
+// copy a lump out of the mapped file (lumps that are modified after loading)
+template<class T>
+void Q3BspLoader::CopyLump(Q3BspWorld *map, LumpTypes lType, std::vector<T> &container, const MappedFile &file)
+{
+    int numElements = map->header.direntries[lType].length / sizeof(T);
+    const T *lumpData = (const T *)(file.Data() + map->header.direntries[lType].offset);
+
+    container.assign(lumpData, lumpData + numElements);
+}
+
+
+// zero-copy lump - span points straight into the mapped file
+template<class T>
+void Q3BspLoader::MapLump(Q3BspWorld *map, LumpTypes lType, Q3BspLumpSpan<T> &span, const MappedFile &file)
+{
+    int numElements = map->header.direntries[lType].length / sizeof(T);
+    const T *lumpData = (const T *)(file.Data() + map->header.direntries[lType].offset);
+
+    span.SetView(numElements > 0 ? lumpData : NULL, numElements);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef Q3BSPLUMPSPAN_INCLUDED
+#define Q3BSPLUMPSPAN_INCLUDED
+
+#include <vector>
+
+/*
+ *  Read-only view over a bsp lump. Data either points straight into a memory mapped
+ *  bsp file or into vector storage owned by the span (regular stream loading).
+ */
+
+template<class T>
+class Q3BspLumpSpan
+{
+public:
+    Q3BspLumpSpan() : m_data(NULL), m_size(0)
+    {
+    }
+
+    // reference lump data owned by someone else (mapped file)
+    void SetView(const T *data, size_t size)
+    {
+        std::vector<T>().swap(m_storage);
+        m_data = data;
+        m_size = size;
+    }
+
+    // take over lump data read into a vector
+    void SetStorage(std::vector<T> &storage)
+    {
+        m_storage.swap(storage);
+        m_data = m_storage.empty() ? NULL : &m_storage[0];
+        m_size = m_storage.size();
+    }
+
+    bool IsMapped() const { return m_data != NULL && m_storage.empty(); }
+
+    const T &operator[](size_t i) const { return m_data[i]; }
+    const T *data()  const { return m_data; }
+    const T *begin() const { return m_data; }
+    const T *end()   const { return m_data + m_size; }
+    size_t   size()  const { return m_size; }
+    bool     empty() const { return m_size == 0; }
+
+private:
+    Q3BspLumpSpan(const Q3BspLumpSpan &);
+    Q3BspLumpSpan &operator=(const Q3BspLumpSpan &);
+
+    const T       *m_data;
+    size_t         m_size;
+    std::vector<T> m_storage;
+};
+
+#endif
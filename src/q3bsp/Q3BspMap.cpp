@@ -1,62 +1,43 @@
 #include "q3bsp/Q3BspMap.hpp"
+#include "q3bsp/Q3BspCache.hpp"
 #include "q3bsp/Q3BspPatch.hpp"
+#include "renderer/CompressedTexture.hpp"
 #include "renderer/ShaderManager.hpp"
 #include "renderer/Texture.hpp"
+#include "renderer/TextureArray.hpp"
 #include "renderer/TextureManager.hpp"
-#include "Math.hpp"
+#include "renderer/UploadRing.hpp"
+#include "ThreadPool.hpp"
+#include "Timer.hpp"
+#include "Trace.hpp"
 #include <algorithm>
+#include <cstring>
 #include <sstream>
 
-const int   Q3BspMap::s_tesselationLevel = 10;   // level of curved surface tesselation
-const float Q3BspMap::s_worldScale       = 48.f; // scale down factor for the map
+const float Q3BspMap::s_textureUploadBudget = 2.f;
 
 Q3BspMap::~Q3BspMap()
 {
-    delete [] entities.ents;
-    delete [] visData.vecs;
+    // decode jobs still running write to this map
+    for (auto &job : m_decodeJobs)
+        job.wait();
+
+    for (auto &decoded : m_decodedTextures)
+        delete decoded.compressed;
+
     delete [] m_lightmapTextures;
 
-    for (auto &it : m_patches)
+    for (auto &it : m_textureArrays)
         delete it;
 
-    for (auto &it : m_renderBuffers.m_faceVBOs)
-    {
-        if (glIsBuffer(it.second.m_vertexBuffer))
-        {
-            glDeleteBuffers(1, &(it.second.m_vertexBuffer));
-        }
+    if (glIsBuffer(m_renderBuffers.m_vertexBuffer))
+        glDeleteBuffers(1, &(m_renderBuffers.m_vertexBuffer));
 
-        if (glIsBuffer(it.second.m_texcoordBuffer))
-        {
-            glDeleteBuffers(1, &(it.second.m_texcoordBuffer));
-        }
+    if (glIsBuffer(m_renderBuffers.m_layerBuffer))
+        glDeleteBuffers(1, &(m_renderBuffers.m_layerBuffer));
 
-        if (glIsBuffer(it.second.m_lightmapTexcoordBuffer))
-        {
-            glDeleteBuffers(1, &(it.second.m_lightmapTexcoordBuffer));
-        }
-    }
-
-    for (auto &it : m_renderBuffers.m_patchVBOs)
-    {
-        for (auto &it2 : it.second)
-        {
-            if (glIsBuffer(it2.m_vertexBuffer))
-            {
-                glDeleteBuffers(1, &(it2.m_vertexBuffer));
-            }
-
-            if (glIsBuffer(it2.m_texcoordBuffer))
-            {
-                glDeleteBuffers(1, &(it2.m_texcoordBuffer));
-            }
-
-            if (glIsBuffer(it2.m_lightmapTexcoordBuffer))
-            {
-                glDeleteBuffers(1, &(it2.m_lightmapTexcoordBuffer));
-            }
-        }
-    }
+    if (glIsBuffer(m_renderBuffers.m_indexBuffer))
+        glDeleteBuffers(1, &(m_renderBuffers.m_indexBuffer));
 
     if (glIsVertexArray(m_renderBuffers.m_vertexArray))
         glDeleteVertexArrays(1, &(m_renderBuffers.m_vertexArray));
@@ -65,83 +46,76 @@ Q3BspMap::~Q3BspMap()
 
 void Q3BspMap::Init()
 {
-    m_missingTex = TextureManager::GetInstance()->LoadTexture("res/missing.png");
-
-    // load textures
-    LoadTextures();
+    Timer totalTimer;
+    Timer stageTimer;
 
-    // load lightmaps
-    LoadLightmaps();
+    // stage 1: cache restore or CPU-only preprocessing
+    Q3BspCache cache;
+    std::vector<Q3BspVertexLump> mapVertices;
+    std::vector<unsigned int>    mapIndices;
+    Preprocess(cache, mapVertices, mapIndices);
 
-    // create renderable faces and patches
-    m_renderLeaves.reserve(leaves.size());
+    stageTimer.Reset();
 
-    for (const auto &l : leaves)
+    if (m_gpuTesselation && ShaderManager::GetInstance()->GetShaderProgram(ShaderManager::BasicTessShader).id == 0)
     {
-        m_renderLeaves.push_back( Q3LeafRenderable() );
-        m_renderLeaves.back().visCluster = l.cluster;
-        m_renderLeaves.back().firstFace  = l.leafFace;
-        m_renderLeaves.back().numFaces   = l.n_leafFaces;
-
-        // create a bounding box
-        m_renderLeaves.back().boundingBoxVertices[0] = Math::Vector3f( (float)l.mins.x, (float)l.mins.y,(float)l.mins.z );
-        m_renderLeaves.back().boundingBoxVertices[1] = Math::Vector3f( (float)l.mins.x, (float)l.mins.y,(float)l.maxs.z );
-        m_renderLeaves.back().boundingBoxVertices[2] = Math::Vector3f( (float)l.mins.x, (float)l.maxs.y,(float)l.mins.z );
-        m_renderLeaves.back().boundingBoxVertices[3] = Math::Vector3f( (float)l.mins.x, (float)l.maxs.y,(float)l.maxs.z );
-        m_renderLeaves.back().boundingBoxVertices[4] = Math::Vector3f( (float)l.maxs.x, (float)l.mins.y,(float)l.mins.z );
-        m_renderLeaves.back().boundingBoxVertices[5] = Math::Vector3f( (float)l.maxs.x, (float)l.mins.y,(float)l.maxs.z );
-        m_renderLeaves.back().boundingBoxVertices[6] = Math::Vector3f( (float)l.maxs.x, (float)l.maxs.y,(float)l.mins.z );
-        m_renderLeaves.back().boundingBoxVertices[7] = Math::Vector3f( (float)l.maxs.x, (float)l.maxs.y,(float)l.maxs.z );
-
-        for (int i = 0; i < 8; ++i)
-        {
-            m_renderLeaves.back().boundingBoxVertices[i].m_x /= Q3BspMap::s_worldScale;
-            m_renderLeaves.back().boundingBoxVertices[i].m_y /= Q3BspMap::s_worldScale;
-            m_renderLeaves.back().boundingBoxVertices[i].m_z /= Q3BspMap::s_worldScale;
-        }
+        LOG_MESSAGE("[Q3BspMap] Tesselation shaders not supported, curved surfaces are tesselated on the CPU");
+        m_gpuTesselation = false;
     }
 
-    m_renderFaces.reserve(faces.size());
-
-    // create the VAO 
-    glGenVertexArrays(1, &(m_renderBuffers.m_vertexArray));
-    glBindVertexArray(m_renderBuffers.m_vertexArray);
-
-    int faceArrayIdx  = 0;
-    int patchArrayIdx = 0;
-
-    for (const auto &f : faces)
-    {
-        m_renderFaces.push_back( Q3FaceRenderable() );
+    m_mapStats.patchesGpuTesselated = m_gpuTesselation;
 
-        //is it a patch?
-        if (f.type == FaceTypePatch)
-        {
-            m_renderFaces.back().index = patchArrayIdx;
-            CreatePatch(f);
+    // stage 2: GL uploads (context thread only) - textures keep streaming in while the map is rendered
+    StartTextureStreaming();
 
-            // generate necessary VBOs for current patch
-            CreateBuffersForPatch(patchArrayIdx);
-            ++patchArrayIdx;
-        }
-        else
-        {
-            m_renderFaces.back().index = faceArrayIdx;
+    // load lightmaps (already gamma corrected)
+    if (m_mapStats.loadedFromCache)
+        LoadLightmaps(cache.Lump<Q3BspLightMapLump>(CacheLightmaps), cache.LumpSize<Q3BspLightMapLump>(CacheLightmaps));
+    else
+        LoadLightmaps(lightMaps.data(), (int)lightMaps.size());
 
-            // generate necessary VBOs for current face
-            CreateBuffersForFace(f, faceArrayIdx);
-        }             
+    // upload map geometry (straight from the mapped cache file if possible)
+    if (m_mapStats.loadedFromCache)
+        CreateMapBuffers(cache.Lump<Q3BspVertexLump>(CacheVertices), cache.Lump<unsigned int>(CacheIndices));
+    else
+        CreateMapBuffers(mapVertices.data(), mapIndices.data());
 
-        ++faceArrayIdx;
-        m_renderFaces.back().type = f.type;
-    }
+    m_mapStats.loadTimeUpload = (float)stageTimer.ElapsedMs();
 
     m_mapStats.totalVertices = vertices.size();
     m_mapStats.totalFaces    = faces.size();
-    m_mapStats.totalPatches  = patchArrayIdx;
+    m_mapStats.totalPatches  = m_patches.size();
+    m_mapStats.loadTimeTotal = (float)totalTimer.ElapsedMs();
+
+    LOG_MESSAGE("[Q3BspMap] Load stages (" << ThreadPool::GetInstance()->NumWorkers() << " workers): "
+                << (m_mapStats.loadedFromCache ? "[cached] " : "")
+                << "cache "     << m_mapStats.loadTimeCache     << "ms, "
+                << "lightmaps " << m_mapStats.loadTimeLightmaps << "ms, "
+                << "leaves "    << m_mapStats.loadTimeLeaves    << "ms, "
+                << "patches "   << m_mapStats.loadTimePatches   << "ms, "
+                << "GL upload " << m_mapStats.loadTimeUpload    << "ms, "
+                << "total "     << m_mapStats.loadTimeTotal     << "ms");
+    LOG_MESSAGE("[Q3BspMap] Geometry: " << NumBufferVertices() << " vertices, " << NumBufferIndices() << " indices"
+                << (m_gpuTesselation ? " (GPU tesselated patches)" : ""));
 
     // set the scale-down uniform
     glUniform1f(ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader).uniforms[WorldScaleFactor], 1.f / Q3BspMap::s_worldScale);
+
+    if (m_gpuTesselation)
+        glUniform1f(ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicTessShader).uniforms[WorldScaleFactor], 1.f / Q3BspMap::s_worldScale);
+}
+
+
+void Q3BspMap::CalculateVisibleFaces(const Math::Vector3f &cameraPosition, const Math::Matrix4f &cullingMatrix)
+{
+    Q3BspWorld::CalculateVisibleFaces(cameraPosition, cullingMatrix);
+    BuildRenderBatches();
+}
+
+
+void Q3BspMap::OnFrameStart()
+{
+    StreamTextures();
 }
 
 
@@ -150,52 +124,39 @@ void Q3BspMap::OnRenderStart()
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
     glCullFace(GL_FRONT);
+
+    // ends every patch triangle strip
+    glEnable(GL_PRIMITIVE_RESTART);
+    glPrimitiveRestartIndex(Q3BspBiquadPatch::s_restartIndex);
 }
 
 
 void Q3BspMap::Render()
-{ 
-    m_frustum.OnRender();
-
-    m_mapStats.visiblePatches = 0;
+{
+    TRACE_SCOPE("Q3BspMap::Render");
 
     if (HasRenderFlag(Q3RenderShowWireframe))
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     else
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-    // render visible faces
-    const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader);
+    // curve error tolerance matches the CPU LOD selection (finest level possible if LOD is disabled)
+    if (m_gpuTesselation)
+    {
+        const ShaderProgram &tessShader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicTessShader);
+        glUniform3f(tessShader.uniforms[CameraPosition], m_cameraPosition.m_x, m_cameraPosition.m_y, m_cameraPosition.m_z);
+        glUniform1f(tessShader.uniforms[TessLodError], HasRenderFlag(Q3RenderSkipPatchLod) ? 1e-6f : s_patchLodError);
+        glPatchParameteri(GL_PATCH_VERTICES, 9);
+    }
 
-    GLuint vertexPosAttr = glGetAttribLocation(shader.id, "inVertex");
-    GLuint texCoordAttr  = glGetAttribLocation(shader.id, "inTexCoord");
-    GLuint lmapCoordAttr = glGetAttribLocation(shader.id, "inTexCoordLightmap");
+    // render visible faces
+    ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader);
 
+    // all faces share the same vertex/index buffers
     glBindVertexArray(m_renderBuffers.m_vertexArray);
 
-    glEnableVertexAttribArray(vertexPosAttr);
-    glEnableVertexAttribArray(texCoordAttr);
-    glEnableVertexAttribArray(lmapCoordAttr);
-
-    for (const auto &vf : m_visibleFaces)
-    {
-        // polygons and meshes are rendered in the same manner
-        if (vf->type == FaceTypePolygon || vf->type == FaceTypeMesh)
-        {
-            RenderFace(vf->index);
-        }
-
-        // render all biquad patches that compose the curved surface
-        if (vf->type == FaceTypePatch)
-        {
-            RenderPatch(vf->index);
-            m_mapStats.visiblePatches++;
-        }
-    }
-
-    glDisableVertexAttribArray(vertexPosAttr);
-    glDisableVertexAttribArray(texCoordAttr);
-    glDisableVertexAttribArray(lmapCoordAttr);
+    // batches were built by CalculateVisibleFaces
+    RenderBatches();
 }
 
 
@@ -203,141 +164,268 @@ void Q3BspMap::OnRenderFinish()
 {
     glDisable(GL_DEPTH_TEST);
     glDisable(GL_CULL_FACE);
+    glDisable(GL_PRIMITIVE_RESTART);
 }
 
 
-// determine if a bsp cluster is visible from a given camera cluster
-bool Q3BspMap::ClusterVisible(int cameraCluster, int testCluster) const
+// set up placeholder materials and queue decoding of all face textures on worker threads
+void Q3BspMap::StartTextureStreaming()
 {
-    if ((visData.vecs == NULL) || (cameraCluster < 0)) {
-        return true;
+    static const unsigned char grey[] = { 128, 128, 128 };
+
+    m_textureArrays.push_back(new TextureArray(1, 1, 1));
+    m_textureArrays.back()->AddLayer(grey, 3);
+    m_textureArrays.back()->GenerateMipmaps();
+    m_mapStats.textureMemory = m_textureArrays.back()->MemorySize();
+
+    m_placeholderMaterial.handle       = InvalidTextureHandle;
+    m_placeholderMaterial.textureArray = 0;
+    m_placeholderMaterial.layer        = 0;
+    m_placeholderMaterial.missing      = false;
+    m_placeholderMaterial.memorySize   = 0;
+
+    m_missingMaterial = m_placeholderMaterial;
+    m_missingMaterial.missing = true;
+
+    Texture *missingTex = TextureManager::GetInstance()->DecodeTexture("res/missing.png");
+
+    if (missingTex)
+    {
+        m_textureArrays.push_back(new TextureArray(missingTex->Width(), missingTex->Height(), 1));
+        m_textureArrays.back()->AddLayer(*missingTex);
+        m_textureArrays.back()->GenerateMipmaps();
+        m_missingMaterial.textureArray = 1;
+        m_mapStats.textureMemory += m_textureArrays.back()->MemorySize();
+
+        TextureManager::GetInstance()->FreeDecodedTexture(missingTex);
     }
 
-    int idx = (cameraCluster * visData.sz_vecs) + (testCluster >> 3);
+    // textures not used by any face are never loaded
+    Q3Material unusedMaterial = { InvalidTextureHandle, -1, 0, false, 0 };
+    m_materials.assign(textures.size(), unusedMaterial);
+    m_textureFaces.assign(textures.size(), std::vector<int>());
 
-    return (visData.vecs[idx] & (1 << (testCluster & 7))) != 0;
-}
+    for (size_t i = 0; i < faces.size(); ++i)
+        m_textureFaces[faces[i].texture].push_back(i);
 
+    m_streamTimer.Reset();
 
-// determine which bsp leaf camera resides in
-int Q3BspMap::FindCameraLeaf(const Math::Vector3f & cameraPosition) const
-{
-    int leafIndex = 0;
+    TextureManager *textureManager = TextureManager::GetInstance();
 
-    while(leafIndex >= 0)
+    for (size_t i = 0; i < textures.size(); ++i)
     {
-        // children.x - front node; children.y - back node
-        if(PointPlanePos( planes[nodes[leafIndex].plane].normal.x,
-                          planes[nodes[leafIndex].plane].normal.y,
-                          planes[nodes[leafIndex].plane].normal.z,
-                          planes[nodes[leafIndex].plane].dist, 
-                          cameraPosition ) == Math::PointInFrontOfPlane )
-        {
-            leafIndex = nodes[leafIndex].children.x; 
-        }
-        else
+        if (m_textureFaces[i].empty())
+            continue;
+
+        int texIdx = (int)i;
+        TextureHandle handle = textureManager->RegisterTexture(textures[texIdx].name);
+
+        m_materials[texIdx] = m_placeholderMaterial;
+        m_materials[texIdx].handle = handle;
+        m_mapStats.totalTextures++;
+
+        textureManager->SetState(handle, TextureLoading);
+
+        // jpg/tga resolution, mip chain building and block compression run here, off the render thread
+        m_decodeJobs.push_back(ThreadPool::GetInstance()->Enqueue([this, texIdx, handle]()
         {
-            leafIndex = nodes[leafIndex].children.y;
-        }
-    }
+            TextureManager *textureManager = TextureManager::GetInstance();
+            Q3DecodedTexture decoded;
+            decoded.textureIdx = texIdx;
+            decoded.width      = 0;
+            decoded.height     = 0;
+            decoded.compressed = NULL;
+
+            if (textureManager->CompressionEnabled())
+            {
+                decoded.compressed = textureManager->DecodeCompressedTexture(handle);
+            }
+            else
+            {
+                Texture *texture = textureManager->DecodeTexture(handle);
+
+                if (texture != NULL)
+                {
+                    decoded.width  = texture->Width();
+                    decoded.height = texture->Height();
+                    CompressedTexture::BuildMipChain(texture->Data(), texture->Width(), texture->Height(), texture->Components(), decoded.levels);
+                    textureManager->FreeDecodedTexture(texture);
+                }
+            }
 
-    return ~leafIndex;
+            std::lock_guard<std::mutex> lock(m_decodedMutex);
+            m_decodedTextures.push_back(std::move(decoded));
+        }));
+    }
 }
 
 
-//Calculate which faces to draw given a camera position & view frustum
-void Q3BspMap::CalculateVisibleFaces(const Math::Vector3f &cameraPosition)
+// upload decoded textures until the per-frame time budget runs out
+void Q3BspMap::StreamTextures()
 {
-    m_visibleFaces.clear();
+    if (m_mapStats.loadedTextures == m_mapStats.totalTextures)
+        return;
 
-    //calculate the camera leaf
-    int cameraLeaf    = FindCameraLeaf(cameraPosition * Q3BspMap::s_worldScale);
-    int cameraCluster = m_renderLeaves[cameraLeaf].visCluster;
+    TRACE_SCOPE("Q3BspMap::StreamTextures");
+    Timer budgetTimer;
 
-    //loop through the leaves
-    for (const auto &rl : m_renderLeaves)
+    while (budgetTimer.ElapsedMs() < s_textureUploadBudget)
     {
-        //if the leaf is not in the PVS - skip it
-        if( !HasRenderFlag( Q3RenderSkipPVS ) && !ClusterVisible(cameraCluster, rl.visCluster) )
-            continue;
+        Q3DecodedTexture decoded;
 
-        //if this leaf does not lie in the frustum - skip it
-        if( !HasRenderFlag( Q3RenderSkipFC ) && !m_frustum.BoxInFrustum(  rl.boundingBoxVertices ) )
-            continue;
-
-        //loop through faces in this leaf and them to visibility set
-        for (int j = 0; j < rl.numFaces; ++j)
         {
-            int idx = leafFaces[ rl.firstFace + j ].face;
-            Q3FaceRenderable *face = &m_renderFaces[ leafFaces[ rl.firstFace + j ].face ];
+            std::lock_guard<std::mutex> lock(m_decodedMutex);
+
+            if (m_decodedTextures.empty())
+                break;
 
-            if(std::find( m_visibleFaces.begin(), m_visibleFaces.end(), face ) == m_visibleFaces.end() )
-                m_visibleFaces.push_back( face );
+            decoded = std::move(m_decodedTextures.back());
+            m_decodedTextures.pop_back();
         }
+
+        AddTexture(decoded);
     }
 
-    m_mapStats.visibleFaces = m_visibleFaces.size();
+    if (m_mapStats.loadedTextures == m_mapStats.totalTextures)
+    {
+        m_mapStats.loadTimeTextures = (float)m_streamTimer.ElapsedMs();
+        LOG_MESSAGE("[Q3BspMap] " << m_mapStats.totalTextures << " textures streamed in " << m_mapStats.loadTimeTextures << "ms ("
+                    << m_textureArrays.size() << " texture arrays)");
+    }
 }
 
 
-void Q3BspMap::LoadTextures()
+// place a streamed texture in a texture array of matching size and format and switch its faces over
+// (takes ownership of the decoded texture)
+void Q3BspMap::AddTexture(const Q3DecodedTexture &decoded)
 {
-    int numTextures = header.direntries[Textures].length / sizeof(Q3BspTextureLump);
+    Q3Material &material = m_materials[decoded.textureIdx];
 
-    m_textures.resize( numTextures );
+    if (decoded.levels.empty() && decoded.compressed == NULL)
+    {
+        std::stringstream sstream;
+        sstream << "Missing texture: " << textures[decoded.textureIdx].name << "\n";
+        LOG_MESSAGE(sstream.str().c_str());
 
-    // load the textures from file (determine wheter it's a jpg or tga)
-    for (const auto &f : faces)
+        TextureHandle handle = material.handle;
+        material        = m_missingMaterial;
+        material.handle = handle;
+    }
+    else if (decoded.compressed != NULL)
     {
-        if (m_textures[f.texture])
-            continue;
+        const CompressedTexture &texture = *decoded.compressed;
+        int arrayIdx = FindTextureArray(texture.Width(), texture.Height(), texture.Format());
+
+        material.textureArray = arrayIdx;
+        material.layer        = m_textureArrays[arrayIdx]->AddLayer(texture);
+        material.missing      = false;
+        material.memorySize   = m_textureArrays[arrayIdx]->LayerSize();
+        m_mapStats.compressedTextures++;
 
-        std::string nameJPG = textures[f.texture].name;
+        delete decoded.compressed;
+    }
+    else
+    {
+        int arrayIdx = FindTextureArray(decoded.width, decoded.height, 0);
+
+        // mip levels were built by the decode job - upload them for this layer only
+        material.textureArray = arrayIdx;
+        material.layer        = m_textureArrays[arrayIdx]->AddLayer(decoded.levels);
+        material.missing      = false;
+        material.memorySize   = m_textureArrays[arrayIdx]->LayerSize();
+        m_mapStats.uncompressedTextures++;
+    }
 
-        nameJPG.append(".jpg");
+    m_mapStats.residentTextureMemory += material.memorySize;
+    m_mapStats.largestTextureMemory   = std::max(m_mapStats.largestTextureMemory, material.memorySize);
 
-        m_textures[f.texture] = TextureManager::GetInstance()->LoadTexture(nameJPG.c_str());
+    TextureManager::GetInstance()->SetState(material.handle, material.missing ? TextureMissing : TextureResident);
+    UpdateVertexLayers(decoded.textureIdx);
+    m_mapStats.loadedTextures++;
+}
 
-        if (m_textures[f.texture] == NULL)
-        {
-            std::string nameTGA = textures[f.texture].name;
-            nameTGA.append(".tga");
 
-            m_textures[f.texture] = TextureManager::GetInstance()->LoadTexture(nameTGA.c_str());
+// non-full texture array for the given size and format (0 for RGBA8), a new one is created if there's none
+int Q3BspMap::FindTextureArray(int width, int height, GLenum compressedFormat)
+{
+    // arrays of the same size double in capacity, so a new one is rarely needed
+    int capacity = 4;
 
-            if (m_textures[f.texture] == NULL)
-            {
-                std::stringstream sstream;
-                sstream << "Missing texture: " << nameTGA.c_str() << "\n";
-                LOG_MESSAGE(sstream.str().c_str());
-            }
-        }
+    for (size_t i = 0; i < m_textureArrays.size(); ++i)
+    {
+        const TextureArray *textureArray = m_textureArrays[i];
+        GLenum format = compressedFormat ? compressedFormat : GL_RGBA8;
+
+        if (textureArray->Width() != width || textureArray->Height() != height || textureArray->Format() != format)
+            continue;
+
+        if (!textureArray->Full())
+            return (int)i;
+
+        capacity = std::max(capacity, 2 * textureArray->NumLayers());
     }
+
+    m_textureArrays.push_back(new TextureArray(width, height, capacity, compressedFormat));
+    m_mapStats.textureMemory += m_textureArrays.back()->MemorySize();
+
+    return (int)m_textureArrays.size() - 1;
 }
 
 
-void Q3BspMap::LoadLightmaps()
+void Q3BspMap::LoadLightmaps(const Q3BspLightMapLump *lightmapData, int numLightmaps)
 {
-    m_lightmapTextures = new GLuint[lightMaps.size()];
+    int tiles     = AtlasTiles();
+    int tileSize  = AtlasTileSize();
+    int numPages  = NumAtlasPages();
+    int atlasSize = tiles * tileSize;
 
-    glGenTextures(lightMaps.size(), m_lightmapTextures);
+    m_lightmapTextures = new GLuint[numPages];
 
-    // optional: change gamma settings of the lightmaps (make them brighter)
-    SetLightmapGamma(2.5f);
+    glGenTextures(numPages, m_lightmapTextures);
 
-    for (size_t i = 0; i < lightMaps.size(); ++i)
+    std::vector<unsigned char> tilePixels(tileSize * tileSize * 3);
+
+    // pack lightmaps into atlas pages (see Q3BspWorld::AtlasLightmapCoords)
+    for (int page = 0; page < numPages; ++page)
     {
-        glBindTexture(GL_TEXTURE_2D, m_lightmapTextures[i]);
+        glBindTexture(GL_TEXTURE_2D, m_lightmapTextures[page]);
         glEnable(GL_TEXTURE_2D); // to fix the "potential" bug on older ATI cards
 
-        // Create texture from bsp lmap data
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 128, 128, 0, GL_RGB, GL_UNSIGNED_BYTE, lightMaps[i].map);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasSize, atlasSize, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+
+        for (int tile = 0; tile < tiles * tiles; ++tile)
+        {
+            int i = page * tiles * tiles + tile;
+
+            if (i >= numLightmaps)
+                break;
+
+            // surround the lightmap with copies of its edge texels so filtering never reaches the neighbouring tiles
+            for (int y = 0; y < tileSize; ++y)
+            {
+                int srcY = std::min(std::max(y - s_lightmapGutter, 0), s_lightmapSize - 1);
+
+                for (int x = 0; x < tileSize; ++x)
+                {
+                    int srcX = std::min(std::max(x - s_lightmapGutter, 0), s_lightmapSize - 1);
+                    memcpy(&tilePixels[(y * tileSize + x) * 3], &lightmapData[i].map[(srcY * s_lightmapSize + srcX) * 3], 3);
+                }
+            }
+
+            const GLvoid *pixels = UploadRing::GetInstance()->Stage(tilePixels.data(), tilePixels.size());
+            glTexSubImage2D(GL_TEXTURE_2D, 0, (tile % tiles) * tileSize, (tile / tiles) * tileSize,
+                            tileSize, tileSize, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+            UploadRing::GetInstance()->Commit();
+        }
+
+        // few mip levels - the gutter only covers texels up to this level, smaller ones would blend neighbouring lightmaps together
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, s_lightmapMaxLevel);
         glGenerateMipmap(GL_TEXTURE_2D);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     }
 
     // Create white texture for if no lightmap specified
@@ -358,212 +446,262 @@ void Q3BspMap::LoadLightmaps()
 }
 
 
-// tweak lightmap gamma settings
-void Q3BspMap::SetLightmapGamma(float gamma)
+// sort visible surfaces by render state and merge adjacent index ranges into batches
+void Q3BspMap::BuildRenderBatches()
 {
-    for (size_t i = 0; i < lightMaps.size(); ++i)
+    m_drawSurfaces.clear();
+    m_renderBatches.clear();
+    m_batchCounts.clear();
+    m_batchOffsets.clear();
+
+    m_mapStats.visiblePatches = 0;
+
+    for (const auto &vf : m_visibleFaces)
     {
-        for (int j = 0; j < 128 * 128; ++j)
+        Q3DrawSurface surface;
+        const Q3Material *material;
+
+        surface.firstIndex  = vf->firstIndex;
+        surface.numIndices  = vf->numIndices;
+
+        // polygons and meshes are rendered in the same manner
+        if (vf->type == FaceTypePolygon || vf->type == FaceTypeMesh)
         {
-            float r, g, b;
-
-            r = lightMaps[i].map[ j*3+0 ];
-            g = lightMaps[i].map[ j*3+1 ];
-            b = lightMaps[i].map[ j*3+2 ];
-
-            r *= gamma / 255.0f;
-            g *= gamma / 255.0f;
-            b *= gamma / 255.0f;
-
-            float scale = 1.0f;
-            float temp;
-            if( r > 1.0f && (temp = (1.0f/r) ) < scale) scale = temp;
-            if( g > 1.0f && (temp = (1.0f/g) ) < scale) scale = temp;
-            if( b > 1.0f && (temp = (1.0f/b) ) < scale) scale = temp;
-
-            scale *= 255.0f;
-            r *= scale;
-            g *= scale;
-            b *= scale;
-
-            lightMaps[i].map[ j*3+0 ] = (GLubyte)r;
-            lightMaps[i].map[ j*3+1 ] = (GLubyte)g;
-            lightMaps[i].map[ j*3+2 ] = (GLubyte)b;
+            material = &m_materials[faces[vf->index].texture];
+            surface.lightmapIdx = AtlasPage(faces[vf->index].lm_index);
+            surface.primitive   = GL_TRIANGLES;
+
+            if (material->missing && HasRenderFlag(Q3RenderSkipMissingTex))
+                continue;
         }
-    }
-}
+        else if (vf->type == FaceTypePatch)
+        {
+            const Q3BspPatch *patch = m_patches[vf->index];
 
+            material = &m_materials[patch->textureIdx];
+            surface.lightmapIdx = AtlasPage(patch->lightmapIdx);
 
-// create a Q3Bsp curved surface
-void Q3BspMap::CreatePatch(const Q3BspFaceLump &f)
-{
-    Q3BspPatch *newPatch = new Q3BspPatch;
+            if (m_gpuTesselation)
+            {
+                // control points of all biquads - tesselation level is picked per edge in the shader
+                surface.primitive  = GL_PATCHES;
+                surface.firstIndex = patch->firstControlIndex;
+                surface.numIndices = 9 * (int)patch->quadraticPatches.size();
+            }
+            else
+            {
+                // index range of the LOD picked by CalculateVisibleFaces
+                surface.primitive  = GL_TRIANGLE_STRIP;
+                surface.firstIndex = patch->firstIndex[patch->lod];
+                surface.numIndices = patch->numIndices[patch->lod];
+            }
+
+            m_mapStats.visiblePatches++;
+        }
+        else
+        {
+            continue;
+        }
+
+        // the texture array layer comes from vertex data - surfaces of any texture of the same size can share a batch
+        surface.textureArray = material->textureArray;
+        surface.missing      = material->missing && surface.primitive == GL_TRIANGLES;
 
-    newPatch->textureIdx  = f.texture;
-    newPatch->lightmapIdx = f.lm_index;
-    newPatch->width  = f.size.x;
-    newPatch->height = f.size.y;
+        surface.sortKey = ((unsigned long long)(surface.primitive != GL_TRIANGLES) << 63) |
+                          ((unsigned long long)surface.missing << 62) |
+                          ((unsigned long long)(surface.textureArray + 1) << 32) |
+                          (unsigned int)(surface.lightmapIdx + 1);
 
-    int numPatchesWidth  = ( newPatch->width - 1  ) >> 1;
-    int numPatchesHeight = ( newPatch->height - 1 ) >> 1;
+        m_drawSurfaces.push_back(surface);
+    }
+
+    // sorting by index offset within the same state lets adjacent faces merge into one range
+    std::sort(m_drawSurfaces.begin(), m_drawSurfaces.end(), [](const Q3DrawSurface &a, const Q3DrawSurface &b)
+    {
+        return a.sortKey < b.sortKey || (a.sortKey == b.sortKey && a.firstIndex < b.firstIndex);
+    });
 
-    newPatch->quadraticPatches.resize( numPatchesWidth*numPatchesHeight );
+    int rangeEnd = -1;
 
-    // generate biquadratic patches (components that make the curved surface)
-    for (int y = 0; y < numPatchesHeight; ++y)
+    for (size_t i = 0; i < m_drawSurfaces.size(); ++i)
     {
-        for (int x = 0; x < numPatchesWidth; ++x)
+        const Q3DrawSurface &surface = m_drawSurfaces[i];
+
+        if (i == 0 || surface.sortKey != m_drawSurfaces[i - 1].sortKey)
         {
-            for (int row = 0; row < 3; ++row)
-            {
-                for (int col = 0; col < 3; ++col)
-                {
-                    int patchIdx = y * numPatchesWidth + x;
-                    int cpIdx = row * 3 + col;
-                    newPatch->quadraticPatches[ patchIdx ].controlPoints[ cpIdx ] = vertices[ f.vertex +
-                                                                                              ( y * 2 * newPatch->width + x * 2 ) +
-                                                                                              row * newPatch->width + col ];
-                }
-            }
+            Q3RenderBatch batch;
+            batch.textureArray = surface.textureArray;
+            batch.missing      = surface.missing;
+            batch.lightmapIdx  = surface.lightmapIdx;
+            batch.primitive   = surface.primitive;
+            batch.firstRange  = m_batchCounts.size();
+            batch.numRanges   = 0;
+
+            m_renderBatches.push_back(batch);
+            rangeEnd = -1;
+        }
 
-            newPatch->quadraticPatches[ y * numPatchesWidth + x ].Tesselate( Q3BspMap::s_tesselationLevel );
+        Q3RenderBatch &batch = m_renderBatches.back();
+
+        if (surface.firstIndex == rangeEnd)
+        {
+            m_batchCounts.back() += surface.numIndices;
+            rangeEnd += surface.numIndices;
+        }
+        else
+        {
+            m_batchCounts.push_back(surface.numIndices);
+            m_batchOffsets.push_back((const GLvoid *)(surface.firstIndex * sizeof(GLuint)));
+            batch.numRanges++;
+            rangeEnd = surface.firstIndex + surface.numIndices;
         }
     }
-
-    m_patches.push_back(newPatch);
 }
 
 
-// render regular faces (polygons + meshes)
-void Q3BspMap::RenderFace(int idx)
+// submit render batches, rebinding textures only when they change
+void Q3BspMap::RenderBatches()
 {
-    const ShaderProgram &shader = ShaderManager::GetInstance()->GetActiveShader();
-    GLuint vertexPosAttr = glGetAttribLocation(shader.id, "inVertex");
-    GLuint texCoordAttr  = glGetAttribLocation(shader.id, "inTexCoord");
-    GLuint lmapCoordAttr = glGetAttribLocation(shader.id, "inTexCoordLightmap");
+    int boundTexture  = -2;
+    int boundLightmap = -2;
 
-    // bind vertices
-    glBindBuffer(GL_ARRAY_BUFFER, m_renderBuffers.m_faceVBOs[idx].m_vertexBuffer);
-    glVertexAttribPointer(vertexPosAttr, 3, GL_FLOAT, GL_FALSE, sizeof(Q3BspVertexLump), (void*)(0));
+    m_mapStats.drawCalls    = 0;
+    m_mapStats.stateChanges = 0;
 
-    // bind texture coords    
-    glBindBuffer(GL_ARRAY_BUFFER, m_renderBuffers.m_faceVBOs[idx].m_texcoordBuffer);
-    glVertexAttribPointer(texCoordAttr, 2, GL_FLOAT, GL_FALSE, sizeof(Q3BspVertexLump), (void*)(0));
-
-    // bind lightmap coords  
-    glBindBuffer(GL_ARRAY_BUFFER, m_renderBuffers.m_faceVBOs[idx].m_lightmapTexcoordBuffer);
-    glVertexAttribPointer(lmapCoordAttr, 2, GL_FLOAT, GL_FALSE, sizeof(Q3BspVertexLump), (void*)(0));
-
-    // bind primary texture
-    glActiveTexture(GL_TEXTURE0);
-    if (m_textures[faces[idx].texture])
-        TextureManager::GetInstance()->BindTexture(m_textures[faces[idx].texture]);
-    else
+    for (const auto &batch : m_renderBatches)
     {
-        if (HasRenderFlag(Q3RenderSkipMissingTex))
+        // bind primary texture array
+        if (batch.textureArray != boundTexture)
         {
-            return;
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, batch.textureArray >= 0 ? m_textureArrays[batch.textureArray]->Id() : 0);
+
+            boundTexture = batch.textureArray;
+            m_mapStats.stateChanges++;
         }
 
-        // render objects with missing textures without culling
-        TextureManager::GetInstance()->BindTexture(m_missingTex);
-        glDisable(GL_CULL_FACE);
-    }
+        // bind a generic white texture if there's no lightmap for this surface
+        if (batch.lightmapIdx != boundLightmap)
+        {
+            glActiveTexture(GL_TEXTURE1);
+            if (batch.lightmapIdx >= 0)
+                glBindTexture(GL_TEXTURE_2D, m_lightmapTextures[batch.lightmapIdx]);
+            else
+                glBindTexture(GL_TEXTURE_2D, m_whiteTex);
+
+            boundLightmap = batch.lightmapIdx;
+            m_mapStats.stateChanges++;
+        }
 
-    // bind a generic white texture if there's no lightmap for this surface
-    glActiveTexture(GL_TEXTURE1);
-    if (faces[idx].lm_index >= 0)
-        glBindTexture(GL_TEXTURE_2D, m_lightmapTextures[faces[idx].lm_index]);
-    else
-        glBindTexture(GL_TEXTURE_2D, m_whiteTex);
+        // render faces with missing textures without culling
+        if (batch.missing)
+            glDisable(GL_CULL_FACE);
 
+        // patches sort last, so the shader is switched at most once
+        if (batch.primitive == GL_PATCHES)
+            ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicTessShader);
 
-    glDrawElements(GL_TRIANGLES, faces[idx].n_meshverts, GL_UNSIGNED_INT, &meshVertices[faces[idx].meshvert]);
+        glMultiDrawElements(batch.primitive, &m_batchCounts[batch.firstRange], GL_UNSIGNED_INT, &m_batchOffsets[batch.firstRange], batch.numRanges);
+        m_mapStats.drawCalls++;
 
-    // reenable culling in case it was disabled by missing texture
-    glEnable(GL_CULL_FACE);
+        if (batch.missing)
+            glEnable(GL_CULL_FACE);
+    }
 }
 
 
-// render curved surface
-void Q3BspMap::RenderPatch(int idx)
+// upload map-wide vertex/index buffers and set up the vertex array
+void Q3BspMap::CreateMapBuffers(const Q3BspVertexLump *vertexData, const unsigned int *indexData)
 {
-    // bind primary texture
-    glActiveTexture(GL_TEXTURE0);
-    if (m_textures[m_patches[idx]->textureIdx])
-        TextureManager::GetInstance()->BindTexture(m_textures[m_patches[idx]->textureIdx]);
-    else
-        TextureManager::GetInstance()->BindTexture(m_missingTex);
-
-    // bind a generic white texture if there's no lightmap for this surface
-    glActiveTexture(GL_TEXTURE1);
-    if (m_patches[idx]->lightmapIdx >= 0)
-        glBindTexture(GL_TEXTURE_2D, m_lightmapTextures[m_patches[idx]->lightmapIdx]);
-    else
-        glBindTexture(GL_TEXTURE_2D, m_whiteTex);
-
-    int numPatches = m_patches[idx]->quadraticPatches.size();
-
-    const ShaderProgram &shader = ShaderManager::GetInstance()->GetActiveShader();
+    const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader);
     GLuint vertexPosAttr = glGetAttribLocation(shader.id, "inVertex");
     GLuint texCoordAttr  = glGetAttribLocation(shader.id, "inTexCoord");
     GLuint lmapCoordAttr = glGetAttribLocation(shader.id, "inTexCoordLightmap");
+    GLuint texLayerAttr  = glGetAttribLocation(shader.id, "inTexLayer");
 
-    for (int i = 0; i < numPatches; ++i)
-    {
-        // bind vertices
-        glBindBuffer(GL_ARRAY_BUFFER, m_renderBuffers.m_patchVBOs[idx][i].m_vertexBuffer);
-        glVertexAttribPointer(vertexPosAttr, 3, GL_FLOAT, GL_FALSE, sizeof(Q3BspVertexLump), (void*)(0));
+    glGenVertexArrays(1, &(m_renderBuffers.m_vertexArray));
+    glBindVertexArray(m_renderBuffers.m_vertexArray);
 
-        // bind texture coords    
-        glBindBuffer(GL_ARRAY_BUFFER, m_renderBuffers.m_patchVBOs[idx][i].m_texcoordBuffer);
-        glVertexAttribPointer(texCoordAttr, 2, GL_FLOAT, GL_FALSE, sizeof(Q3BspVertexLump), (void*)(0));
+    glGenBuffers(1, &(m_renderBuffers.m_vertexBuffer));
+    glBindBuffer(GL_ARRAY_BUFFER, m_renderBuffers.m_vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Q3BspVertexLump) * NumBufferVertices(), vertexData, GL_STATIC_DRAW);
 
-        // bind lightmap coords  
-        glBindBuffer(GL_ARRAY_BUFFER, m_renderBuffers.m_patchVBOs[idx][i].m_lightmapTexcoordBuffer);
-        glVertexAttribPointer(lmapCoordAttr, 2, GL_FLOAT, GL_FALSE, sizeof(Q3BspVertexLump), (void*)(0));
+    // index buffer binding is stored in the VAO
+    glGenBuffers(1, &(m_renderBuffers.m_indexBuffer));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_renderBuffers.m_indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * NumBufferIndices(), indexData, GL_STATIC_DRAW);
 
-        m_patches[idx]->quadraticPatches[i].Render();
-    }
-}
+    // interleaved layout: position, texture coords, lightmap coords
+    glEnableVertexAttribArray(vertexPosAttr);
+    glEnableVertexAttribArray(texCoordAttr);
+    glEnableVertexAttribArray(lmapCoordAttr);
 
+    glVertexAttribPointer(vertexPosAttr, 3, GL_FLOAT, GL_FALSE, sizeof(Q3BspVertexLump), (void*)offsetof(Q3BspVertexLump, position));
+    glVertexAttribPointer(texCoordAttr,  2, GL_FLOAT, GL_FALSE, sizeof(Q3BspVertexLump), (void*)offsetof(Q3BspVertexLump, texcoord[0]));
+    glVertexAttribPointer(lmapCoordAttr, 2, GL_FLOAT, GL_FALSE, sizeof(Q3BspVertexLump), (void*)offsetof(Q3BspVertexLump, texcoord[1]));
 
-void Q3BspMap::CreateBuffersForFace(const Q3BspFaceLump &face, int idx)
-{
-    glGenBuffers(1, &(m_renderBuffers.m_faceVBOs[idx].m_vertexBuffer));
-    glBindBuffer(GL_ARRAY_BUFFER, m_renderBuffers.m_faceVBOs[idx].m_vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Q3BspVertexLump) * face.n_vertexes, &(vertices[face.vertex].position), GL_STATIC_DRAW);
+    // texture array layers in a separate buffer - the vertex buffer layout matches the bsp/cache file
+    std::vector<float> vertexLayers;
+    BuildVertexLayers(vertexLayers);
 
-    glGenBuffers(1, &(m_renderBuffers.m_faceVBOs[idx].m_texcoordBuffer));
-    glBindBuffer(GL_ARRAY_BUFFER, m_renderBuffers.m_faceVBOs[idx].m_texcoordBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Q3BspVertexLump) * face.n_vertexes, &(vertices[face.vertex].texcoord[0]), GL_STATIC_DRAW);
+    glGenBuffers(1, &(m_renderBuffers.m_layerBuffer));
+    glBindBuffer(GL_ARRAY_BUFFER, m_renderBuffers.m_layerBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * NumBufferVertices(), vertexLayers.data(), GL_STATIC_DRAW);
 
-    glGenBuffers(1, &(m_renderBuffers.m_faceVBOs[idx].m_lightmapTexcoordBuffer));
-    glBindBuffer(GL_ARRAY_BUFFER, m_renderBuffers.m_faceVBOs[idx].m_lightmapTexcoordBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Q3BspVertexLump) * face.n_vertexes, &(vertices[face.vertex].texcoord[1]), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(texLayerAttr);
+    glVertexAttribPointer(texLayerAttr, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+
+    glBindVertexArray(0);
 }
 
 
-void Q3BspMap::CreateBuffersForPatch(int idx)
+// texture array layer of every map vertex (each vertex belongs to exactly one face or patch)
+void Q3BspMap::BuildVertexLayers(std::vector<float> &vertexLayers) const
 {
-    int numPatches = m_patches[idx]->quadraticPatches.size();
+    vertexLayers.assign(NumBufferVertices(), 0.f);
 
-    for (int i = 0; i < numPatches; i++)
+    for (size_t i = 0; i < faces.size(); ++i)
     {
-        m_renderBuffers.m_patchVBOs[idx].push_back(FaceBuffers());
+        const Q3BspFaceLump &f = faces[i];
+        float layer = (float)m_materials[f.texture].layer;
+
+        // bsp vertices (patch control points included)
+        std::fill(vertexLayers.begin() + f.vertex, vertexLayers.begin() + f.vertex + f.n_vertexes, layer);
+
+        if (f.type == FaceTypePatch && !m_gpuTesselation)
+        {
+            for (const auto &bq : m_patches[m_renderFaces[i].index]->quadraticPatches)
+                std::fill(vertexLayers.begin() + bq.FirstVertex(), vertexLayers.begin() + bq.FirstVertex() + bq.NumVertices(), layer);
+        }
+    }
+}
+
+
+// rewrite texture array layers of all faces using a texture (after it was streamed in)
+void Q3BspMap::UpdateVertexLayers(int textureIdx)
+{
+    std::vector<float> layers;
+    float layer = (float)m_materials[textureIdx].layer;
 
-        int numVerts = m_patches[idx]->quadraticPatches[i].m_vertices.size();
+    glBindBuffer(GL_ARRAY_BUFFER, m_renderBuffers.m_layerBuffer);
 
-        glGenBuffers(1, &(m_renderBuffers.m_patchVBOs[idx][i].m_vertexBuffer));
-        glBindBuffer(GL_ARRAY_BUFFER, m_renderBuffers.m_patchVBOs[idx][i].m_vertexBuffer);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(Q3BspVertexLump) * numVerts, &(m_patches[idx]->quadraticPatches[i].m_vertices[0].position), GL_STATIC_DRAW);
+    for (int faceIdx : m_textureFaces[textureIdx])
+    {
+        const Q3BspFaceLump &f = faces[faceIdx];
 
-        glGenBuffers(1, &(m_renderBuffers.m_patchVBOs[idx][i].m_texcoordBuffer));
-        glBindBuffer(GL_ARRAY_BUFFER, m_renderBuffers.m_patchVBOs[idx][i].m_texcoordBuffer);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(Q3BspVertexLump) * numVerts, &(m_patches[idx]->quadraticPatches[i].m_vertices[0].texcoord[0]), GL_STATIC_DRAW);
+        if (f.n_vertexes > 0)
+        {
+            layers.assign(f.n_vertexes, layer);
+            glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * f.vertex, sizeof(float) * layers.size(), layers.data());
+        }
 
-        glGenBuffers(1, &(m_renderBuffers.m_patchVBOs[idx][i].m_lightmapTexcoordBuffer));
-        glBindBuffer(GL_ARRAY_BUFFER, m_renderBuffers.m_patchVBOs[idx][i].m_lightmapTexcoordBuffer);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(Q3BspVertexLump) * numVerts, &(m_patches[idx]->quadraticPatches[i].m_vertices[0].texcoord[1]), GL_STATIC_DRAW);
+        if (f.type == FaceTypePatch && !m_gpuTesselation)
+        {
+            for (const auto &bq : m_patches[m_renderFaces[faceIdx].index]->quadraticPatches)
+            {
+                layers.assign(bq.NumVertices(), layer);
+                glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * bq.FirstVertex(), sizeof(float) * layers.size(), layers.data());
+            }
+        }
     }
 }
\ No newline at end of file
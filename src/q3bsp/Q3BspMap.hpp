@@ -1,89 +1,150 @@
 #ifndef Q3BSPMAP_INCLUDED
 #define Q3BSPMAP_INCLUDED
 
-#include "Frustum.hpp"
-#include "common/BspMap.hpp"
-#include "q3bsp/Q3Bsp.hpp"
+#include "q3bsp/Q3BspWorld.hpp"
+#include "renderer/CompressedTexture.hpp"
 #include "renderer/OpenGL.hpp"
+#include "renderer/TextureManager.hpp"
+#include "Timer.hpp"
+#include <future>
+#include <mutex>
 #include <vector>
-#include <map>
+#include <string>
 
 class  Texture;
-struct Q3BspPatch;
+class  TextureArray;
+
+
+// world texture as a layer of one of the map texture arrays
+struct Q3Material
+{
+    TextureHandle handle; // registered bsp texture name (InvalidTextureHandle for helper materials)
+    int  textureArray;    // -1 if the texture isn't used by any face
+    int  layer;
+    bool missing;         // texture file not found - layer holds the "missing" texture
+    size_t memorySize;    // video memory of its own layer including mip levels (0 for placeholder/missing)
+};
+
+
+// texture decoded on a worker thread, waiting for upload
+struct Q3DecodedTexture
+{
+    int textureIdx;
+    int width;
+    int height;
+    CompressedTexture::MipChain levels;  // RGBA8 mip chain, empty if neither .jpg nor .tga could be loaded
+    CompressedTexture *compressed;       // used instead of levels if compression is enabled
+};
+
+
+// visible surface queued for rendering
+struct Q3DrawSurface
+{
+    unsigned long long sortKey;  // render state (non-triangle primitive, missing texture, texture array, lightmap)
+    int    textureArray;
+    bool   missing;
+    int    lightmapIdx;  // lightmap atlas page (-1 if none)
+    GLenum primitive;
+    int    firstIndex;
+    int    numIndices;
+};
+
+
+// index ranges sharing the same render state - submitted with a single glMultiDrawElements call
+// (patch triangle strips are separated by primitive restart, so they join like triangle lists)
+struct Q3RenderBatch
+{
+    int    textureArray;
+    bool   missing;      // faces with missing textures are rendered without culling
+    int    lightmapIdx;  // lightmap atlas page (-1 if none)
+    GLenum primitive;
+    int    firstRange;   // first entry in batch count/offset arrays
+    int    numRanges;
+};
+
+
+// single interleaved vertex buffer and index buffer for the entire map
+struct RenderBuffers
+{
+    RenderBuffers() : m_vertexArray(0), m_vertexBuffer(0), m_layerBuffer(0), m_indexBuffer(0)
+    {
+    }
+
+    GLuint m_vertexArray;
+    GLuint m_vertexBuffer;   // Q3BspVertexLump: bsp vertices followed by tesselated patch vertices (bsp vertices only for GPU tesselation)
+    GLuint m_layerBuffer;    // texture array layer of each vertex (float)
+    GLuint m_indexBuffer;    // face mesh vertices (absolute), patch control points and patch triangle strips with restart indices (no strips for GPU tesselation)
+};
+
 
 /*
  *  Quake III map 
  */
 
-class Q3BspMap : public BspMap
+class Q3BspMap : public Q3BspWorld
 {
 public:
-    static const int   s_tesselationLevel; // level of curved surface tesselation
-    static const float s_worldScale;       // scale down factor for the map
-
-    Q3BspMap() : BspMap(), m_lightmapTextures(NULL)
+    // curved surfaces are evaluated in tesselation shaders if requested and supported, CPU tesselated otherwise
+    Q3BspMap(bool gpuTesselation = false) : Q3BspWorld(), m_lightmapTextures(NULL), m_gpuTesselation(gpuTesselation)
     {
     }
 
     ~Q3BspMap();
 
     void Init();
+    // culling followed by render queue setup - runs once per frame, Render() may be called for each eye
+    void CalculateVisibleFaces(const Math::Vector3f &cameraPosition, const Math::Matrix4f &cullingMatrix);
+    void OnFrameStart();
     void OnRenderStart();
     void Render();
     void OnRenderFinish();
 
-    bool ClusterVisible(int cameraCluster, int testCluster)   const;
-    int  FindCameraLeaf(const Math::Vector3f &cameraPosition) const;
-    void CalculateVisibleFaces(const Math::Vector3f &cameraPosition);   
-
-    // bsp data
-    Q3BspHeader     header;
-    Q3BspEntityLump entities;
-    std::vector<Q3BspTextureLump>   textures;
-    std::vector<Q3BspPlaneLump>     planes;
-    std::vector<Q3BspNodeLump>      nodes;
-    std::vector<Q3BspLeafLump>      leaves;
-    std::vector<Q3BspLeafFaceLump>  leafFaces;
-    std::vector<Q3BspLeafBrushLump> leafBrushes;
-    std::vector<Q3BspModelLump>     models;
-    std::vector<Q3BspBrushLump>     brushes;
-    std::vector<Q3BspBrushSideLump> brushSides;
-    std::vector<Q3BspVertexLump>    vertices;
-    std::vector<Q3BspMeshVertLump>  meshVertices;
-    std::vector<Q3BspEffectLump>    effects;
-    std::vector<Q3BspFaceLump>      faces;
-    std::vector<Q3BspLightMapLump>  lightMaps;
-    std::vector<Q3BspLightVolLump>  lightVols;
-    Q3BspVisDataLump                visData;
-
 private:
-    void LoadTextures();
-    void LoadLightmaps();
-    void SetLightmapGamma(float gamma);
-    void CreatePatch(const Q3BspFaceLump &f);
-    void RenderFace(int idx);
-    void RenderPatch(int idx);
+    static const float s_textureUploadBudget;  // max time spent on texture uploads per frame (ms)
 
-    // VBO creation
-    void CreateBuffersForFace(const Q3BspFaceLump &face, int idx);
-    void CreateBuffersForPatch(int idx);
+    // texture streaming: textures are decoded on worker threads and uploaded by StreamTextures() a few per frame,
+    // faces render with a flat placeholder until their texture arrives
+    void StartTextureStreaming();
+    void StreamTextures();
+    void AddTexture(const Q3DecodedTexture &decoded);
+    int  FindTextureArray(int width, int height, GLenum compressedFormat);
+    void UpdateVertexLayers(int textureIdx);
 
-    // render data
-    std::vector<Q3LeafRenderable>   m_renderLeaves; // bsp leaves in "renderable format"
-    std::vector<Q3FaceRenderable>   m_renderFaces;  // bsp faces in "renderable format"
+    // GL upload stages (context thread)
+    void LoadLightmaps(const Q3BspLightMapLump *lightmapData, int numLightmaps);
 
-    std::vector<Q3BspPatch *>       m_patches;      // curved surfaces
-    std::vector<Texture *>          m_textures;     // loaded in-game textures
-    std::vector<Q3FaceRenderable *> m_visibleFaces; // list of visible surfaces to render
-    GLuint  *m_lightmapTextures;                    // bsp lightmaps 
+    void CreateMapBuffers(const Q3BspVertexLump *vertexData, const unsigned int *indexData);
+    void BuildVertexLayers(std::vector<float> &vertexLayers) const;
+    int  NumBufferVertices() const { return m_gpuTesselation ? (int)vertices.size() : m_numMapVertices; }
+    int  NumBufferIndices()  const { return m_gpuTesselation ? m_numControlIndices : m_numMapIndices; }
 
-    Frustum  m_frustum;                             // view frustum
+    // render queue
+    void BuildRenderBatches();
+    void RenderBatches();
 
-    // helper textures
-    Texture *m_missingTex;   // rendered if an in-game texture is missing
-    GLuint   m_whiteTex;     // used if no lightmap specified for a face
+    // render data
+    std::vector<Q3Material>         m_materials;    // material of each bsp texture
+    std::vector<TextureArray *>     m_textureArrays;// in-game textures grouped by size
+    std::vector<Q3DrawSurface>      m_drawSurfaces; // visible surfaces sorted by render state
+    std::vector<Q3RenderBatch>      m_renderBatches;
+    std::vector<GLsizei>            m_batchCounts;  // index count of each batch draw range
+    std::vector<const GLvoid *>     m_batchOffsets; // index buffer offset of each batch draw range
+    GLuint  *m_lightmapTextures;                    // bsp lightmap atlas pages
+    bool     m_gpuTesselation;                      // patches are drawn as GL_PATCHES of 9 control points
 
-    // rendering buffers (VAO + VBO)
+    // helper textures
+    GLuint     m_whiteTex;            // used if no lightmap specified for a face
+    Q3Material m_placeholderMaterial; // flat grey, used until a texture is streamed in
+    Q3Material m_missingMaterial;     // used if an in-game texture is missing
+
+    // texture streaming state
+    std::vector<Q3DecodedTexture>    m_decodedTextures; // filled by decode jobs
+    std::mutex                       m_decodedMutex;
+    std::vector< std::future<void> > m_decodeJobs;
+    std::vector< std::vector<int> >  m_textureFaces;    // faces using each bsp texture
+    Timer                            m_streamTimer;
+
+    // rendering buffers (VAO + map-wide VBO/IBO)
     RenderBuffers m_renderBuffers;
 };
 
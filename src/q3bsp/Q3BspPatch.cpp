@@ -1,84 +1,219 @@
 #include "q3bsp/Q3BspPatch.hpp"
-#include "renderer/OpenGL.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <emmintrin.h>
 
+// channels interpolated per vertex: position, texture coords, lightmap coords, normal (stored as floats)
+// followed by the RGBA color (converted to floats)
+static const int s_numFloatChannels = 10;
+static const int s_numChannels      = s_numFloatChannels + 4;
+static const int s_normalChannel    = 7;
+static const int s_colorChannel     = s_numFloatChannels;
 
-void Q3BspBiquadPatch::Tesselate(int tessLevel)
+static_assert(offsetof(Q3BspVertexLump, normal) == s_normalChannel * sizeof(float), "unexpected vertex layout");
+static_assert(offsetof(Q3BspVertexLump, color) == s_numFloatChannels * sizeof(float), "float vertex channels must precede vertex color");
+
+
+// quadratic bernstein weights at i / tessLevel
+static inline void BernsteinWeights(int i, int tessLevel, __m128 *weights)
 {
-    m_tesselationLevel = tessLevel;
-    m_vertices.resize( (m_tesselationLevel + 1) * (m_tesselationLevel + 1) );
+    float a = (float)i / tessLevel;
+    float b = 1.f - a;
 
-    for (int i = 0; i <= m_tesselationLevel; ++i)
-    {
-        float a = (float)i / m_tesselationLevel;
-        float b = 1.f - a;
+    weights[0] = _mm_set1_ps(b * b);
+    weights[1] = _mm_set1_ps(2 * b * a);
+    weights[2] = _mm_set1_ps(a * a);
+}
 
-        m_vertices[i]= controlPoints[0] * (b * b) +
-                       controlPoints[3] * (2 * b * a) +
-                       controlPoints[6] * (a * a);
-    }
 
-    for (int i = 1; i <= m_tesselationLevel; ++i)
+// evaluate one tesselation level of 4 biquads at once - lane k of every channel belongs to vertices[k]
+static void TesselateLevel(const __m128 (*controlPoints)[s_numChannels], int tessLevel, Q3BspVertexLump **vertices, int numLanes)
+{
+    for (int i = 0; i <= tessLevel; ++i)
     {
-        float a = (float)i / m_tesselationLevel;
-        float b = 1.f - a;
+        __m128 wi[3];
+        BernsteinWeights(i, tessLevel, wi);
 
-        Q3BspVertexLump temp[3];
+        // collapse control point rows to a quadratic curve at parameter i
+        __m128 rows[3][s_numChannels];
 
-        for (int j = 0, k = 0; j < 3; ++j, k = 3 * j)
+        for (int r = 0; r < 3; ++r)
         {
-            temp[j] = controlPoints[k + 0] * ( b * b ) +
-                      controlPoints[k + 1] * ( 2 * b * a) +
-                      controlPoints[k + 2] * ( a * a );
+            for (int c = 0; c < s_numChannels; ++c)
+            {
+                rows[r][c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(controlPoints[r * 3 + 0][c], wi[0]),
+                                                   _mm_mul_ps(controlPoints[r * 3 + 1][c], wi[1])),
+                                        _mm_mul_ps(controlPoints[r * 3 + 2][c], wi[2]));
+            }
         }
 
-        for (int j = 0; j <= m_tesselationLevel; ++j)
+        for (int j = 0; j <= tessLevel; ++j)
         {
-            float a = (float)j / m_tesselationLevel;
-            float b = 1.f - a;
+            __m128 wj[3];
+            BernsteinWeights(j, tessLevel, wj);
+
+            __m128 v[16];
+
+            for (int c = 0; c < s_numChannels; ++c)
+                v[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rows[0][c], wj[0]), _mm_mul_ps(rows[1][c], wj[1])), _mm_mul_ps(rows[2][c], wj[2]));
+
+            // blended normals are shorter than unit length - degenerate ones are left as they are
+            __m128 *n = &v[s_normalChannel];
+            __m128 length  = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(n[0], n[0]), _mm_mul_ps(n[1], n[1])), _mm_mul_ps(n[2], n[2])));
+            __m128 invalid = _mm_cmple_ps(length, _mm_set1_ps(1e-6f));
+            __m128 scale   = _mm_or_ps(_mm_andnot_ps(invalid, _mm_div_ps(_mm_set1_ps(1.f), length)), _mm_and_ps(invalid, _mm_set1_ps(1.f)));
+
+            for (int c = 0; c < 3; ++c)
+                n[c] = _mm_mul_ps(n[c], scale);
+
+            // colors as one packed RGBA value per lane (weights sum to 1, so they stay in 0..255 up to rounding)
+            __m128 *color = &v[s_colorChannel];
+            _MM_TRANSPOSE4_PS(color[0], color[1], color[2], color[3]);
+
+            int packedColors[4];
+
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                __m128i rgba = _mm_cvtps_epi32(color[lane]);
+                rgba = _mm_packs_epi32(rgba, rgba);
+                packedColors[lane] = _mm_cvtsi128_si32(_mm_packus_epi16(rgba, rgba));
+            }
+
+            // channels of 4 vertices -> 4 vertices of 12 float channels
+            v[10] = _mm_setzero_ps();
+            v[11] = _mm_setzero_ps();
+
+            _MM_TRANSPOSE4_PS(v[0], v[1], v[2],  v[3]);
+            _MM_TRANSPOSE4_PS(v[4], v[5], v[6],  v[7]);
+            _MM_TRANSPOSE4_PS(v[8], v[9], v[10], v[11]);
 
-            m_vertices[i * (m_tesselationLevel + 1) + j] = temp[0] * ( b * b ) +
-                                                           temp[1] * ( 2 * b * a ) +
-                                                           temp[2] * ( a * a );
+            for (int lane = 0; lane < numLanes; ++lane)
+            {
+                Q3BspVertexLump &vertex = vertices[lane][i * (tessLevel + 1) + j];
+                float *channels = &vertex.position.x;
+
+                _mm_storeu_ps(channels,     v[lane]);
+                _mm_storeu_ps(channels + 4, v[4 + lane]);
+                _mm_storel_pi((__m64 *)(channels + 8), v[8 + lane]);
+
+                memcpy(vertex.color, &packedColors[lane], sizeof(vertex.color));
+            }
         }
     }
+}
 
-    m_indices.resize( m_tesselationLevel * ( m_tesselationLevel + 1 ) * 2 );
 
-    for (int row = 0; row < m_tesselationLevel; ++row)
+void Q3BspPatch::Tesselate(const Q3BspVertexLump *controlGrid, Q3BspVertexLump *vertexBuffer, unsigned int *indexBuffer) const
+{
+    int numBiquads = (int)quadraticPatches.size();
+
+    for (int first = 0; first < numBiquads; first += 4)
     {
-        for (int col = 0; col <= m_tesselationLevel; ++col)
+        // unused lanes repeat the last biquad and are not written
+        int numLanes = std::min(4, numBiquads - first);
+        const Q3BspBiquadPatch *biquads[4];
+
+        for (int lane = 0; lane < 4; ++lane)
+            biquads[lane] = &quadraticPatches[first + std::min(lane, numLanes - 1)];
+
+        // structure of arrays: channel c of control point i of all 4 biquads
+        __m128 controlPoints[9][s_numChannels];
+
+        for (int i = 0; i < 9; ++i)
         {
-            m_indices[( row * (m_tesselationLevel + 1) + col ) * 2 + 1] =  row      * (m_tesselationLevel + 1) + col;
-            m_indices[( row * (m_tesselationLevel + 1) + col ) * 2]     = (row + 1) * (m_tesselationLevel + 1) + col;
+            const Q3BspVertexLump *cp[4];
+
+            for (int lane = 0; lane < 4; ++lane)
+                cp[lane] = &controlGrid[biquads[lane]->ControlIndex(i, width)];
+
+            for (int c = 0; c < s_numFloatChannels; ++c)
+                controlPoints[i][c] = _mm_set_ps((&cp[3]->position.x)[c], (&cp[2]->position.x)[c], (&cp[1]->position.x)[c], (&cp[0]->position.x)[c]);
+
+            for (int c = 0; c < 4; ++c)
+                controlPoints[i][s_colorChannel + c] = _mm_set_ps(cp[3]->color[c], cp[2]->color[c], cp[1]->color[c], cp[0]->color[c]);
         }
-    }
 
-    m_trianglesPerRow  = new int[m_tesselationLevel];
-    m_rowIndexPointers = new unsigned int *[m_tesselationLevel];
+        // all biquads of a surface share the tesselation levels
+        int vertexOffset = 0;
 
-    for (int row = 0; row < m_tesselationLevel; ++row)
-    {
-        m_trianglesPerRow[row] = 2 * (m_tesselationLevel + 1);
-        m_rowIndexPointers[row] = &m_indices[row * 2 * (m_tesselationLevel + 1)];
-    }
-}
+        for (int lod = 0; lod < Q3BspBiquadPatch::s_numLods; ++lod)
+        {
+            Q3BspVertexLump *vertices[4];
 
+            for (int lane = 0; lane < 4; ++lane)
+                vertices[lane] = vertexBuffer + biquads[lane]->FirstVertex() + vertexOffset;
+
+            TesselateLevel(controlPoints, biquads[0]->TesselationLevel(lod), vertices, numLanes);
+            vertexOffset += biquads[0]->NumVertices(lod);
+        }
+    }
 
-void Q3BspBiquadPatch::Render()
-{    
-    // render the patch
-    if (!GL_EXT_multi_draw_arrays)
+    // one triangle strip per row, each followed by a restart index
+    for (const auto &bq : quadraticPatches)
     {
-        for (int row = 0; row < m_tesselationLevel; ++row)
+        int baseVertex = bq.FirstVertex();
+
+        for (int lod = 0; lod < Q3BspBiquadPatch::s_numLods; ++lod)
         {
-            glDrawElements(GL_TRIANGLE_STRIP, 2 * (m_tesselationLevel + 1), GL_UNSIGNED_INT,
-                            &m_indices[row * 2 * (m_tesselationLevel + 1)]);
+            int tessLevel = bq.TesselationLevel(lod);
+            unsigned int *indices = indexBuffer + bq.FirstIndex(lod);
+
+            for (int row = 0; row < tessLevel; ++row)
+            {
+                for (int col = 0; col <= tessLevel; ++col)
+                {
+                    *indices++ = baseVertex + (row + 1) * (tessLevel + 1) + col;
+                    *indices++ = baseVertex +  row      * (tessLevel + 1) + col;
+                }
+
+                *indices++ = Q3BspBiquadPatch::s_restartIndex;
+            }
+
+            baseVertex += bq.NumVertices(lod);
         }
     }
-    else 
-    {
-        glMultiDrawElementsEXT(GL_TRIANGLE_STRIP, m_trianglesPerRow,
-                               GL_UNSIGNED_INT, (const void **)m_rowIndexPointers,
-                               m_tesselationLevel); 
-    } 
 }
+
+
+void Q3BspBiquadPatch::SetBufferRange(const int *tessLevels, int firstVertex)
+{
+    std::copy(tessLevels, tessLevels + s_numLods, m_tesselationLevels);
+    m_firstVertex = firstVertex;
+}
+
+
+int Q3BspBiquadPatch::NumVertices() const
+{
+    int numVertices = 0;
+
+    for (int lod = 0; lod < s_numLods; ++lod)
+        numVertices += NumVertices(lod);
+
+    return numVertices;
+}
+
+
+// the second difference d = p0 - 2p1 + p2 of a quadratic bezier row bounds its deviation from a chord
+// spanning 1/n of the curve by |d| / (4n^2) - rows and columns combined give |d|max / (2n^2)
+float Q3BspBiquadPatch::CurvatureError(const Q3BspVertexLump *controlGrid, int gridWidth) const
+{
+    float maxDiff = 0.f;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        const vec3f &r0 = controlGrid[ControlIndex(i * 3, gridWidth)].position;
+        const vec3f &r1 = controlGrid[ControlIndex(i * 3 + 1, gridWidth)].position;
+        const vec3f &r2 = controlGrid[ControlIndex(i * 3 + 2, gridWidth)].position;
+        const vec3f &c0 = controlGrid[ControlIndex(i, gridWidth)].position;
+        const vec3f &c1 = controlGrid[ControlIndex(i + 3, gridWidth)].position;
+        const vec3f &c2 = controlGrid[ControlIndex(i + 6, gridWidth)].position;
+
+        Math::Vector3f rowDiff(r0.x - 2.f * r1.x + r2.x, r0.y - 2.f * r1.y + r2.y, r0.z - 2.f * r1.z + r2.z);
+        Math::Vector3f colDiff(c0.x - 2.f * c1.x + c2.x, c0.y - 2.f * c1.y + c2.y, c0.z - 2.f * c1.z + c2.z);
+
+        maxDiff = std::max(maxDiff, std::max(rowDiff.Length(), colDiff.Length()));
+    }
+
+    return maxDiff * 0.5f;
+}
\ No newline at end of file
@@ -1,47 +1,78 @@
 #ifndef Q3BSPPATCH_INCLUDED
 #define Q3BSPPATCH_INCLUDED
 
-#include "q3bsp/Q3BspMap.hpp"
+#include "q3bsp/Q3Bsp.hpp"
+#include "Math.hpp"
+#include <vector>
 
 
 // Quake III BSP curved surface component ( biquadratic (3x3) patch )
+// control points are not copied - they are addressed in the control point grid of the surface (the bsp vertices of its face)
 class Q3BspBiquadPatch
 {
 public:
-    Q3BspBiquadPatch() : m_tesselationLevel(0), 
-                         m_trianglesPerRow(NULL), 
-                         m_rowIndexPointers(NULL)
-    {
-    }
+    static const int s_numLods = 4;     // tesselation levels kept per patch (see Q3BspWorld::s_patchLodLevels)
+    static const unsigned int s_restartIndex = 0xFFFFFFFF;  // primitive restart index ending every triangle strip
 
-    ~Q3BspBiquadPatch()
+    Q3BspBiquadPatch() : m_controlOffset(0), m_firstVertex(0)
     {
-        delete [] m_trianglesPerRow;
-        delete [] m_rowIndexPointers;
+        for (int i = 0; i < s_numLods; ++i)
+        {
+            m_tesselationLevels[i] = 0;
+            m_firstIndices[i]      = 0;
+        }
     }
 
-    void Tesselate(int tessLevel);      // perform tesselation 
-    void Render();
+    // first (top left) control point of the patch in the control point grid
+    void SetControlOffset(int controlOffset) { m_controlOffset = controlOffset; }
+    // control point i (row major 3x3) in a control point grid of the given width
+    int  ControlIndex(int i, int gridWidth) const { return m_controlOffset + (i / 3) * gridWidth + i % 3; }
+
+    // place the patch in map-wide vertex/index buffers, vertices of all LODs are consecutive,
+    // index ranges are assigned per LOD (see Q3BspPatch::Tesselate)
+    void SetBufferRange(const int *tessLevels, int firstVertex);
+    void SetIndexRange(int lod, int firstIndex) { m_firstIndices[lod] = firstIndex; }
+    int  TesselationLevel(int lod) const { return m_tesselationLevels[lod]; }
+    int  NumVertices(int lod) const { return (m_tesselationLevels[lod] + 1) * (m_tesselationLevels[lod] + 1); }
+    int  NumIndices(int lod)  const { return m_tesselationLevels[lod] * ((m_tesselationLevels[lod] + 1) * 2 + 1); }  // restart indices included
+    int  NumVertices() const;           // all LODs
+    int  FirstVertex() const { return m_firstVertex; }
+    int  FirstIndex(int lod) const { return m_firstIndices[lod]; }
+
+    // a level n tesselation deviates from the curved surface by at most CurvatureError() / n^2
+    float CurvatureError(const Q3BspVertexLump *controlGrid, int gridWidth) const;
 
-    Q3BspVertexLump controlPoints[9];
-    std::vector<Q3BspVertexLump> m_vertices;
 private:
-    int                          m_tesselationLevel;    
-    std::vector<unsigned int>    m_indices;
-    int*                         m_trianglesPerRow;   // store as pointer arrays for easier access by GL functions
-    unsigned int**               m_rowIndexPointers;  //  - " -
+    int m_controlOffset;                // offset of the first control point in the control point grid
+    int m_tesselationLevels[s_numLods];
+    int m_firstVertex;                  // offset of first vertex (LOD 0) in map vertex buffer
+    int m_firstIndices[s_numLods];      // offset of first index of each LOD in map index buffer
 };
 
 
 // Quake III BSP curved surface (an array of biquadratic patches)
 struct Q3BspPatch
 {
+    // batch tesselation of every LOD of all biquads straight into their map-wide buffer ranges:
+    // control points of 4 biquads at a time are gathered into structure of arrays form and evaluated with SSE
+    // (controlGrid: the width x height bsp vertices of the surface)
+    void Tesselate(const Q3BspVertexLump *controlGrid, Q3BspVertexLump *vertexBuffer, unsigned int *indexBuffer) const;
+
     int textureIdx;   // surface texture index
     int lightmapIdx;  // surface lightmap index
     int width;
     int height;
 
     std::vector<Q3BspBiquadPatch> quadraticPatches;
+
+    // LOD selection - all biquads share one LOD, so edges between them always match
+    Math::Vector3f mins;    // control point bounds (viewer units)
+    Math::Vector3f maxs;
+    float curvatureError;   // max Q3BspBiquadPatch::CurvatureError() (viewer units)
+    int   lod;              // LOD picked for the current frame
+    int   firstIndex[Q3BspBiquadPatch::s_numLods];  // index range of each LOD (all biquads combined)
+    int   numIndices[Q3BspBiquadPatch::s_numLods];
+    int   firstControlIndex;                        // 9 control point indices (bsp vertices) per biquad for GPU tesselation
 };
 
 #endif
\ No newline at end of file
@@ -1,12 +1,12 @@
 #ifndef Q3BSPRENDERHELPERS_INCLUDED
 #define Q3BSPRENDERHELPERS_INCLUDED
 
-#include "renderer/OpenGL.hpp"
+#include "Math.hpp"
 #include <vector>
 #include <map>
 
 /*
- * Helper structs for Q3BspMap rendering
+ * Helper structs for Q3BspMap culling and rendering
  */
 
 enum Q3BspRenderFlags
@@ -17,7 +17,8 @@ enum Q3BspRenderFlags
     Q3RenderAlphaTest      = 1 << 3,
     Q3RenderSkipMissingTex = 1 << 4,
     Q3RenderSkipPVS        = 1 << 5,
-    Q3RenderSkipFC         = 1 << 6
+    Q3RenderSkipFC         = 1 << 6,
+    Q3RenderSkipPatchLod   = 1 << 7
 };
 
 
@@ -27,33 +28,27 @@ struct Q3LeafRenderable
     int visCluster;
     int firstFace;
     int numFaces;
-    Math::Vector3f boundingBoxVertices[8];
 };
 
 
-// face structure used for rendering
-struct Q3FaceRenderable
+// node structure used for hierarchical culling
+struct Q3NodeRenderable
 {
-    int type;
-    int index;
+    Math::Vector3f mins;
+    Math::Vector3f maxs;
+    int parent;                     // -1 for root node
+    unsigned int pvsStamp;          // last PVS (see Q3BspMap::UpdatePVS) with a visible leaf in this subtree
 };
 
 
-// VBO handles for a single face in the BSP
-struct FaceBuffers
-{
-    GLuint m_vertexBuffer;
-    GLuint m_texcoordBuffer;
-    GLuint m_lightmapTexcoordBuffer;
-};
-
-
-struct RenderBuffers
+// face structure used for rendering
+struct Q3FaceRenderable
 {
-    GLuint m_vertexArray; // single vertex vertex array for the entire map
-
-    std::map< int, FaceBuffers > m_faceVBOs;
-    std::map< int, std::vector<FaceBuffers> > m_patchVBOs;
+    int type;
+    int index;
+    int firstIndex;   // offset into map index buffer
+    int numIndices;   // index count (for patches: LOD 0 of all biquads combined, see Q3BspPatch)
+    unsigned int lastVisibleFrame;  // last visible set the face was added to
 };
 
 
@@ -64,7 +59,29 @@ struct BspStats
                  totalFaces(0), 
                  visibleFaces(0), 
                  totalPatches(0), 
-                 visiblePatches(0)
+                 visiblePatches(0),
+                 visiblePatchTriangles(0),
+                 patchesGpuTesselated(false),
+                 drawCalls(0),
+                 stateChanges(0),
+                 totalTextures(0),
+                 loadedTextures(0),
+                 textureMemory(0),
+                 residentTextureMemory(0),
+                 largestTextureMemory(0),
+                 compressedTextures(0),
+                 uncompressedTextures(0),
+                 visibleSetTime(0.f),
+                 pvsCacheHits(0),
+                 pvsCacheMisses(0),
+                 loadTimeTextures(0.f),
+                 loadTimeLightmaps(0.f),
+                 loadTimeLeaves(0.f),
+                 loadTimePatches(0.f),
+                 loadTimeUpload(0.f),
+                 loadTimeCache(0.f),
+                 loadTimeTotal(0.f),
+                 loadedFromCache(false)
     {
     }
 
@@ -73,6 +90,30 @@ struct BspStats
     int visibleFaces;
     int totalPatches;
     int visiblePatches;
+    int visiblePatchTriangles; // curved surface triangles at the selected LODs
+    bool patchesGpuTesselated; // curved surfaces are evaluated in tesselation shaders (triangle count unknown)
+    int drawCalls;      // glMultiDrawElements calls issued for the map
+    int stateChanges;   // texture/lightmap binds between batches
+    int totalTextures;  // textures used by map faces
+    int loadedTextures; // textures streamed in so far (including missing ones)
+    size_t textureMemory; // allocated texture array storage including mip levels and empty layers (bytes)
+    size_t residentTextureMemory; // storage of the streamed in textures (bytes)
+    size_t largestTextureMemory;  // storage of the largest streamed in texture (bytes)
+    int compressedTextures;       // streamed in textures stored block compressed
+    int uncompressedTextures;     // streamed in textures stored as RGBA8
+    float visibleSetTime; // time spent in CalculateVisibleFaces (milliseconds)
+    int pvsCacheHits;     // frames reusing the PVS of the previous camera cluster
+    int pvsCacheMisses;   // PVS rebuilds after the camera changed clusters
+
+    // map load stage timings (milliseconds)
+    float loadTimeTextures;   // texture streaming (until the last texture is uploaded)
+    float loadTimeLightmaps;  // lightmap gamma correction
+    float loadTimeLeaves;     // renderable leaf creation
+    float loadTimePatches;    // curved surface tesselation
+    float loadTimeUpload;     // GL uploads (textures, lightmaps, buffers)
+    float loadTimeCache;      // map cache validation/restore or writing
+    float loadTimeTotal;
+    bool  loadedFromCache;    // preprocessing skipped thanks to the .bspc cache
 };
 
 
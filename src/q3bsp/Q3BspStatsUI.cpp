@@ -1,8 +1,14 @@
 #include "Application.hpp"
 #include "q3bsp/Q3BspMap.hpp"
 #include "q3bsp/Q3BspStatsUI.hpp"
+#include "renderer/FrameProfiler.hpp"
 #include "renderer/OculusVR.hpp"
 #include "renderer/RenderContext.hpp"
+#include "renderer/ShaderManager.hpp"
+#include "renderer/TextureManager.hpp"
+#include "renderer/UploadRing.hpp"
+#include <algorithm>
+#include <iomanip>
 #include <sstream>
 
 extern RenderContext g_renderContext;
@@ -41,7 +47,7 @@ void Q3StatsUI::Render()
     static const float statsX   = g_application.VREnabled() ? -0.19f : -0.99f;
     static const float keysX    = g_application.VREnabled() ? -0.19f :  0.35f;
     static const float statsY   = g_application.VREnabled() ?  0.25f :  0.70f;
-    static const float keysY    = g_application.VREnabled() ? -0.02f : -0.25f;
+    static const float keysY    = g_application.VREnabled() ? -0.32f : -0.25f;
     static const float ySpacing = 0.05f;
 
     const BspStats &stats = m_map->GetMapStats();
@@ -65,8 +71,45 @@ void Q3StatsUI::Render()
 
     statsStream.str("");
     statsStream << "Rendered patches: " << stats.visiblePatches;
+
+    if (stats.patchesGpuTesselated)
+        statsStream << " (GPU tesselated)";
+    else
+        statsStream << " (" << stats.visiblePatchTriangles << " triangles)";
+
     m_font->drawText(statsStream.str(), statsX, statsY - ySpacing * 4.f, 0.);
 
+    statsStream.str("");
+    statsStream << "Draw calls: " << stats.drawCalls << " (state changes: " << stats.stateChanges << ")";
+    m_font->drawText(statsStream.str(), statsX, statsY - ySpacing * 5.f, 0.f);
+
+    statsStream.str("");
+    statsStream << "Visible set: " << (int)(stats.visibleSetTime * 1000.f) << " us";
+    m_font->drawText(statsStream.str(), statsX, statsY - ySpacing * 6.f, 0.f);
+
+    statsStream.str("");
+    statsStream << "PVS cache hits/misses: " << stats.pvsCacheHits << "/" << stats.pvsCacheMisses;
+    m_font->drawText(statsStream.str(), statsX, statsY - ySpacing * 7.f, 0.f);
+
+    statsStream.str("");
+    statsStream << "Map load time: " << (int)stats.loadTimeTotal << " ms" << (stats.loadedFromCache ? " (cached)" : "")
+                << ", textures: " << stats.loadedTextures << "/" << stats.totalTextures;
+    m_font->drawText(statsStream.str(), statsX, statsY - ySpacing * 8.f, 0.f);
+
+    statsStream.str("");
+    statsStream << std::fixed << std::setprecision(1) << "Texture memory: " << stats.residentTextureMemory / (1024.f * 1024.f) << " MB resident, "
+                << stats.textureMemory / (1024.f * 1024.f) << " MB allocated" << (TextureManager::GetInstance()->CompressionEnabled() ? " (BC1/BC3)" : " (RGBA8)");
+    m_font->drawText(statsStream.str(), statsX, statsY - ySpacing * 9.f, 0.f);
+
+    // missing textures share one layer and aren't counted
+    int residentTextures = stats.compressedTextures + stats.uncompressedTextures;
+
+    statsStream.str("");
+    statsStream << std::fixed << std::setprecision(1) << "Per texture: avg " << (residentTextures ? stats.residentTextureMemory / 1024.f / residentTextures : 0.f)
+                << " KB, max " << stats.largestTextureMemory / 1024.f << " KB (" << stats.compressedTextures << " BC1/BC3, "
+                << stats.uncompressedTextures << " RGBA8)";
+    m_font->drawText(statsStream.str(), statsX, statsY - ySpacing * 10.f, 0.f);
+
     m_font->SetColor(Math::Vector4f(1.f, 0.f, 0.f, 1.f));
     m_font->drawText(" ~ - toggle stats view", keysX, keysY, 0.f);
 
@@ -114,4 +157,133 @@ void Q3StatsUI::Render()
         m_font->drawText("F8 - multisampling (MSAA)", keysX, keysY - ySpacing * 8.f, 0.f);
         m_font->SetColor(Math::Vector4f(1.f, 1.f, 1.f, 1.f));
     }
+
+    if (FrameProfiler::GetInstance()->CsvCaptureActive())
+        m_font->SetColor(Math::Vector4f(0.f, 1.f, 0.f, 1.f));
+    m_font->drawText("F9 - capture frame times (CSV)", keysX, keysY - ySpacing * (g_application.VREnabled() ? 9.f : 8.f), 0.f);
+    m_font->SetColor(Math::Vector4f(1.f, 1.f, 1.f, 1.f));
+
+    if (!m_map->HasRenderFlag(Q3RenderSkipPatchLod))
+        m_font->SetColor(Math::Vector4f(0.f, 1.f, 0.f, 1.f));
+    m_font->drawText("F11 - curved surface LOD", keysX, keysY - ySpacing * (g_application.VREnabled() ? 10.f : 9.f), 0.f);
+    m_font->SetColor(Math::Vector4f(1.f, 1.f, 1.f, 1.f));
+
+    // frame timings above the map stats in VR, below them otherwise
+    if (g_application.VREnabled())
+    {
+        RenderTimings(statsX, 0.70f, ySpacing);
+        RenderFrameGraph(statsX, -0.97f, 0.6f, 0.15f);
+    }
+    else
+    {
+        RenderTimings(statsX, statsY - ySpacing * 10.f, ySpacing);
+        RenderFrameGraph(statsX, -0.95f, 0.6f, 0.4f);
+    }
+}
+
+
+// min/avg/p99 of the last FrameProfiler::s_historySize frames
+void Q3StatsUI::RenderTimings(float x, float y, float ySpacing)
+{
+    const FrameProfiler *profiler = FrameProfiler::GetInstance();
+
+    std::stringstream timingStream;
+    timingStream << std::fixed << std::setprecision(2);
+
+    ProfileSummary summary = profiler->FrameSummary();
+    timingStream << "Frame (min/avg/p99): " << summary.minTime << "/" << summary.avgTime << "/" << summary.p99Time << " ms";
+    m_font->drawText(timingStream.str(), x, y, 0.f);
+
+    for (int i = 0; i < NumProfileZones; ++i)
+    {
+        y -= ySpacing;
+        summary = profiler->CpuSummary((ProfileZone)i);
+
+        timingStream.str("");
+        timingStream << "  CPU " << FrameProfiler::ZoneName((ProfileZone)i) << ": " << summary.minTime << "/" << summary.avgTime << "/" << summary.p99Time << " ms";
+        m_font->drawText(timingStream.str(), x, y, 0.f);
+    }
+
+    for (int i = 0; i < NumProfileZones; ++i)
+    {
+        if (!FrameProfiler::ZoneHasGpuTimer((ProfileZone)i))
+            continue;
+
+        y -= ySpacing;
+        summary = profiler->GpuSummary((ProfileZone)i);
+
+        timingStream.str("");
+        timingStream << "  GPU " << FrameProfiler::ZoneName((ProfileZone)i) << ": " << summary.minTime << "/" << summary.avgTime << "/" << summary.p99Time << " ms";
+        m_font->drawText(timingStream.str(), x, y, 0.f);
+    }
+
+    timingStream.str("");
+    timingStream << "Texture uploads: " << UploadRing::GetInstance()->FrameBytes() / 1024.f << " KB last frame, "
+                 << UploadRing::GetInstance()->TotalBytes() / (1024.f * 1024.f) << " MB total";
+    m_font->drawText(timingStream.str(), x, y - ySpacing, 0.f);
+}
+
+
+// rolling graph of frame (grey), CPU (yellow) and GPU (green) times, newest frame on the right
+void Q3StatsUI::RenderFrameGraph(float x, float y, float w, float h)
+{
+    const FrameProfiler *profiler = FrameProfiler::GetInstance();
+
+    // graph spans two target frame times (90 Hz in VR, 60 Hz otherwise)
+    const float targetTime = g_application.VREnabled() ? 1000.f / 90.f : 1000.f / 60.f;
+    const float scale      = h / (2.f * targetTime);
+    const float barWidth   = w / FrameProfiler::s_historySize;
+
+    GLboolean depthOn = glIsEnabled(GL_DEPTH_TEST);
+    GLboolean blendOn = glIsEnabled(GL_BLEND);
+
+    ShaderManager::GetInstance()->DisableShader();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(-1.f, 1.f, -1.f, 1.f, -1.f, 1.f);
+
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+
+    glBegin(GL_LINES);
+    for (int age = 0; age < profiler->NumFrames(); ++age)
+    {
+        float barX    = x + w - (age + 0.5f) * barWidth;
+        float cpuTime = profiler->CpuTime(ProfileUpdate, age) + profiler->CpuTime(ProfileRender, age) + profiler->CpuTime(ProfileStatsUI, age);
+
+        glColor3f(0.4f, 0.4f, 0.4f);
+        glVertex2f(barX, y);
+        glVertex2f(barX, y + std::min(profiler->FrameTime(age) * scale, h));
+
+        glColor3f(1.f, 1.f, 0.f);
+        glVertex2f(barX, y);
+        glVertex2f(barX, y + std::min(cpuTime * scale, h));
+    }
+
+    // target frame time
+    glColor3f(1.f, 0.f, 0.f);
+    glVertex2f(x, y + targetTime * scale);
+    glVertex2f(x + w, y + targetTime * scale);
+    glEnd();
+
+    // GPU times lag one frame behind, frames without results are skipped
+    glColor3f(0.f, 1.f, 0.f);
+    glBegin(GL_POINTS);
+    for (int age = 0; age < profiler->NumFrames(); ++age)
+    {
+        float gpuTime = profiler->GpuFrameTime(age);
+
+        if (gpuTime >= 0.f)
+            glVertex2f(x + w - (age + 0.5f) * barWidth, y + std::min(gpuTime * scale, h));
+    }
+    glEnd();
+
+    if (depthOn)
+        glEnable(GL_DEPTH_TEST);
+
+    if (blendOn)
+        glEnable(GL_BLEND);
 }
@@ -21,6 +21,9 @@ public:
     void Render();
 
 private:
+    void RenderTimings(float x, float y, float ySpacing);
+    void RenderFrameGraph(float x, float y, float w, float h);
+
     Font *m_font;
 };
 
@@ -0,0 +1,741 @@
+#include "q3bsp/Q3BspWorld.hpp"
+#include "q3bsp/Q3BspCache.hpp"
+#include "q3bsp/Q3BspPatch.hpp"
+#include "Math.hpp"
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+#include "Timer.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+#include <cfloat>
+
+const int   Q3BspWorld::s_tesselationLevel = 10;   // level of curved surface tesselation
+const int   Q3BspWorld::s_patchLodLevels[Q3BspBiquadPatch::s_numLods] = { s_tesselationLevel, 6, 3, 1 };
+const float Q3BspWorld::s_patchLodError    = 0.0015f; // about a pixel on current HMDs and 1080p at 90 degrees fov
+const float Q3BspWorld::s_worldScale       = 48.f; // scale down factor for the map
+const float Q3BspWorld::s_lightmapGamma    = 2.5f; // lightmap brightness boost
+const int   Q3BspWorld::s_lightmapSize     = 128;  // width/height of a bsp lightmap
+const int   Q3BspWorld::s_lightmapMaxLevel = 3;
+const int   Q3BspWorld::s_lightmapGutter   = 1 << s_lightmapMaxLevel; // one texel of the last mip level
+const int   Q3BspWorld::s_maxAtlasTiles    = 16;   // 2304x2304 lightmap atlas pages
+
+Q3BspWorld::~Q3BspWorld()
+{
+    delete [] entities.ents;
+
+    // vis data points straight into the mapped file if the map was memory mapped
+    if (!m_mappedFile)
+        delete [] visData.vecs;
+
+    delete m_mappedFile;
+
+    for (auto &it : m_patches)
+        delete it;
+}
+
+
+void Q3BspWorld::Init()
+{
+    Timer totalTimer;
+
+    // no GL uploads - preprocessed geometry is only needed to bake the cache
+    Q3BspCache cache;
+    std::vector<Q3BspVertexLump> mapVertices;
+    std::vector<unsigned int>    mapIndices;
+    Preprocess(cache, mapVertices, mapIndices);
+
+    m_mapStats.totalVertices = vertices.size();
+    m_mapStats.totalFaces    = faces.size();
+    m_mapStats.totalPatches  = m_patches.size();
+    m_mapStats.loadTimeTotal = (float)totalTimer.ElapsedMs();
+}
+
+
+void Q3BspWorld::Preprocess(Q3BspCache &cache, std::vector<Q3BspVertexLump> &mapVertices, std::vector<unsigned int> &mapIndices)
+{
+    Timer stageTimer;
+
+    // try to skip remaining preprocessing with data baked by a previous run
+    std::string cacheFilename;
+    unsigned long long bspHash = 0;
+
+    if (!m_filename.empty())
+    {
+        bspHash       = ComputeBspHash();
+        cacheFilename = Q3BspCache::CacheFilename(m_filename);
+
+        m_mapStats.loadedFromCache = cache.Open(cacheFilename, bspHash, s_tesselationLevel, s_lightmapGamma) && LoadFromCache(cache);
+    }
+
+    m_mapStats.loadTimeCache = (float)stageTimer.ElapsedMs();
+    stageTimer.Reset();
+
+    // culling data is cheap to set up and is not cached
+    CreateRenderNodes();
+    CreateClusterLeaves();
+    CreateLeafBounds();
+
+    if (!m_mapStats.loadedFromCache)
+    {
+        // stale cache may still be mapped - it's rewritten below
+        cache.Close();
+
+        // optional: change gamma settings of the lightmaps (make them brighter)
+        ThreadPool::GetInstance()->ParallelFor((int)lightMaps.size(), [this](int i)
+        {
+            SetLightmapGamma(lightMaps[i], s_lightmapGamma);
+        });
+
+        m_mapStats.loadTimeLightmaps = (float)stageTimer.ElapsedMs();
+        stageTimer.Reset();
+
+        // create renderable leaves
+        m_renderLeaves.resize(leaves.size());
+
+        ThreadPool::GetInstance()->ParallelFor((int)leaves.size(), [this](int i)
+        {
+            CreateRenderLeaf(leaves[i], m_renderLeaves[i]);
+        });
+
+        m_mapStats.loadTimeLeaves = (float)stageTimer.ElapsedMs();
+        stageTimer.Reset();
+
+        // set up curved surfaces (tesselated straight into the map buffers by BuildGeometry)
+        std::vector<int> patchFaces;
+
+        for (size_t i = 0; i < faces.size(); ++i)
+        {
+            if (faces[i].type == FaceTypePatch)
+                patchFaces.push_back(i);
+        }
+
+        m_patches.resize(patchFaces.size());
+
+        ThreadPool::GetInstance()->ParallelFor((int)patchFaces.size(), [this, &patchFaces](int i)
+        {
+            m_patches[i] = CreatePatch(faces[patchFaces[i]]);
+        });
+
+        // merge faces and tesselated patches into map-wide vertex/index buffers
+        CreateRenderFaces();
+        BuildGeometry(mapVertices, mapIndices);
+
+        m_mapStats.loadTimePatches = (float)stageTimer.ElapsedMs();
+        stageTimer.Reset();
+
+        // bake the results for next time
+        if (!cacheFilename.empty() && !WriteCache(cacheFilename, bspHash, mapVertices, mapIndices))
+        {
+            LOG_MESSAGE("[Q3BspWorld] Could not write map cache: " << cacheFilename);
+        }
+
+        m_mapStats.loadTimeCache += (float)stageTimer.ElapsedMs();
+        stageTimer.Reset();
+    }
+}
+
+
+// determine if a bsp cluster is visible from a given camera cluster
+bool Q3BspWorld::ClusterVisible(int cameraCluster, int testCluster) const
+{
+    if ((visData.vecs == NULL) || (cameraCluster < 0)) {
+        return true;
+    }
+
+    int idx = (cameraCluster * visData.sz_vecs) + (testCluster >> 3);
+
+    return (visData.vecs[idx] & (1 << (testCluster & 7))) != 0;
+}
+
+
+// determine which bsp leaf camera resides in
+int Q3BspWorld::FindCameraLeaf(const Math::Vector3f & cameraPosition) const
+{
+    int leafIndex = 0;
+
+    while(leafIndex >= 0)
+    {
+        // children.x - front node; children.y - back node
+        if(PointPlanePos( planes[nodes[leafIndex].plane].normal.x,
+                          planes[nodes[leafIndex].plane].normal.y,
+                          planes[nodes[leafIndex].plane].normal.z,
+                          planes[nodes[leafIndex].plane].dist, 
+                          cameraPosition ) == Math::PointInFrontOfPlane )
+        {
+            leafIndex = nodes[leafIndex].children.x; 
+        }
+        else
+        {
+            leafIndex = nodes[leafIndex].children.y;
+        }
+    }
+
+    return ~leafIndex;
+}
+
+
+//Calculate which faces to draw given a camera position & view frustum
+void Q3BspWorld::CalculateVisibleFaces(const Math::Vector3f &cameraPosition, const Math::Matrix4f &cullingMatrix)
+{
+    Timer visibleSetTimer;
+
+    m_cameraPosition = cameraPosition;
+    m_frustum.Update(cullingMatrix);
+    m_visibleFaces.clear();
+
+    // faces stamped with the current frame are already in the visible set
+    if (++m_visibleFrame == 0)
+    {
+        for (auto &rf : m_renderFaces)
+            rf.lastVisibleFrame = 0;
+
+        m_visibleFrame = 1;
+    }
+
+    //calculate the camera leaf
+    m_cameraLeaf      = FindCameraLeaf(cameraPosition * Q3BspWorld::s_worldScale);
+    int cameraCluster = m_renderLeaves[m_cameraLeaf].visCluster;
+
+    bool usePVS = !HasRenderFlag( Q3RenderSkipPVS );
+    bool useFC  = !HasRenderFlag( Q3RenderSkipFC );
+
+    if (usePVS)
+        UpdatePVS(cameraCluster);
+
+    // walk the bsp tree - child index and whether its parent was fully inside the frustum
+    m_cullLeaves.clear();
+    m_nodeStack.clear();
+    m_nodeStack.push_back(std::make_pair(0, !useFC));
+
+    while (!m_nodeStack.empty())
+    {
+        int  idx    = m_nodeStack.back().first;
+        bool inside = m_nodeStack.back().second;
+        m_nodeStack.pop_back();
+
+        if (idx < 0)
+        {
+            //if the leaf is not in the PVS - skip it
+            if (usePVS && m_leafPVSStamps[~idx] != m_pvsStamp)
+                continue;
+
+            // leaves not known to be inside the frustum are tested in one batch after traversal
+            if (inside)
+                AddVisibleLeafFaces(m_renderLeaves[~idx]);
+            else
+                m_cullLeaves.push_back(~idx);
+
+            continue;
+        }
+
+        const Q3NodeRenderable &node = m_renderNodes[idx];
+
+        // no PVS-visible leaves in this subtree
+        if (usePVS && node.pvsStamp != m_pvsStamp)
+            continue;
+
+        // reject whole subtree if it's outside the frustum, skip further tests if it's fully inside
+        if (!inside)
+        {
+            FrustumTestResult result = m_frustum.TestBox(node.mins, node.maxs);
+
+            if (result == BoxOutside)
+                continue;
+
+            inside = (result == BoxInside);
+        }
+
+        m_nodeStack.push_back(std::make_pair(nodes[idx].children.x, inside));
+        m_nodeStack.push_back(std::make_pair(nodes[idx].children.y, inside));
+    }
+
+    //if a leaf does not lie in the frustum - skip it
+    m_cullResults.resize(m_cullLeaves.size());
+    m_frustum.BoxesInFrustum(m_leafBounds, m_cullLeaves.data(), (int)m_cullLeaves.size(), m_cullResults.data());
+
+    for (size_t i = 0; i < m_cullLeaves.size(); ++i)
+    {
+        if (m_cullResults[i])
+            AddVisibleLeafFaces(m_renderLeaves[m_cullLeaves[i]]);
+    }
+
+    SelectPatchLods(cameraPosition);
+
+    m_mapStats.visibleFaces   = m_visibleFaces.size();
+    m_mapStats.visibleSetTime = (float)visibleSetTimer.ElapsedMs();
+}
+
+
+// stamp leaves in the PVS of the camera cluster and all nodes leading to them
+void Q3BspWorld::UpdatePVS(int cameraCluster)
+{
+    // camera still in the same cluster - stamps are up to date
+    if (cameraCluster == m_pvsCluster)
+    {
+        m_mapStats.pvsCacheHits++;
+        return;
+    }
+
+    m_mapStats.pvsCacheMisses++;
+    m_pvsCluster = cameraCluster;
+
+    if (++m_pvsStamp == 0)
+    {
+        std::fill(m_leafPVSStamps.begin(), m_leafPVSStamps.end(), 0);
+
+        for (auto &rn : m_renderNodes)
+            rn.pvsStamp = 0;
+
+        m_pvsStamp = 1;
+    }
+
+    for (size_t cluster = 0; cluster < m_clusterLeaves.size(); ++cluster)
+    {
+        if (!ClusterVisible(cameraCluster, cluster))
+            continue;
+
+        for (int leaf : m_clusterLeaves[cluster])
+        {
+            m_leafPVSStamps[leaf] = m_pvsStamp;
+
+            // stop at the first node already stamped by another leaf
+            for (int node = m_leafParents[leaf]; node >= 0 && m_renderNodes[node].pvsStamp != m_pvsStamp; node = m_renderNodes[node].parent)
+                m_renderNodes[node].pvsStamp = m_pvsStamp;
+        }
+    }
+}
+
+
+// add faces of a leaf to the visibility set
+void Q3BspWorld::AddVisibleLeafFaces(const Q3LeafRenderable &renderLeaf)
+{
+    for (int j = 0; j < renderLeaf.numFaces; ++j)
+    {
+        Q3FaceRenderable *face = &m_renderFaces[ leafFaces[ renderLeaf.firstFace + j ].face ];
+
+        if (face->lastVisibleFrame != m_visibleFrame)
+        {
+            face->lastVisibleFrame = m_visibleFrame;
+            m_visibleFaces.push_back( face );
+        }
+    }
+}
+
+
+// pick the coarsest LOD of each visible curved surface with projected error below s_patchLodError
+void Q3BspWorld::SelectPatchLods(const Math::Vector3f &cameraPosition)
+{
+    bool useLod = !HasRenderFlag( Q3RenderSkipPatchLod );
+
+    m_mapStats.visiblePatchTriangles = 0;
+
+    for (const auto &vf : m_visibleFaces)
+    {
+        if (vf->type != FaceTypePatch)
+            continue;
+
+        Q3BspPatch *patch = m_patches[vf->index];
+        patch->lod = 0;
+
+        if (useLod)
+        {
+            // distance to the closest point of the patch bounds
+            Math::Vector3f delta(std::max(std::max(patch->mins.m_x - cameraPosition.m_x, cameraPosition.m_x - patch->maxs.m_x), 0.f),
+                                 std::max(std::max(patch->mins.m_y - cameraPosition.m_y, cameraPosition.m_y - patch->maxs.m_y), 0.f),
+                                 std::max(std::max(patch->mins.m_z - cameraPosition.m_z, cameraPosition.m_z - patch->maxs.m_z), 0.f));
+
+            float maxError = s_patchLodError * delta.Length();
+
+            for (int lod = Q3BspBiquadPatch::s_numLods - 1; lod > 0; --lod)
+            {
+                if (patch->curvatureError <= maxError * s_patchLodLevels[lod] * s_patchLodLevels[lod])
+                {
+                    patch->lod = lod;
+                    break;
+                }
+            }
+        }
+
+        int tessLevel = s_patchLodLevels[patch->lod];
+        m_mapStats.visiblePatchTriangles += (int)patch->quadraticPatches.size() * tessLevel * tessLevel * 2;
+    }
+}
+
+
+// tweak lightmap gamma settings
+void Q3BspWorld::SetLightmapGamma(Q3BspLightMapLump &lightMap, float gamma)
+{
+    for (int j = 0; j < 128 * 128; ++j)
+    {
+        float r, g, b;
+
+        r = lightMap.map[ j*3+0 ];
+        g = lightMap.map[ j*3+1 ];
+        b = lightMap.map[ j*3+2 ];
+
+        r *= gamma / 255.0f;
+        g *= gamma / 255.0f;
+        b *= gamma / 255.0f;
+
+        float scale = 1.0f;
+        float temp;
+        if( r > 1.0f && (temp = (1.0f/r) ) < scale) scale = temp;
+        if( g > 1.0f && (temp = (1.0f/g) ) < scale) scale = temp;
+        if( b > 1.0f && (temp = (1.0f/b) ) < scale) scale = temp;
+
+        scale *= 255.0f;
+        r *= scale;
+        g *= scale;
+        b *= scale;
+
+        lightMap.map[ j*3+0 ] = (unsigned char)r;
+        lightMap.map[ j*3+1 ] = (unsigned char)g;
+        lightMap.map[ j*3+2 ] = (unsigned char)b;
+    }
+}
+
+
+// create a leaf used for PVS/frustum culling
+void Q3BspWorld::CreateRenderLeaf(const Q3BspLeafLump &l, Q3LeafRenderable &renderLeaf) const
+{
+    renderLeaf.visCluster = l.cluster;
+    renderLeaf.firstFace  = l.leafFace;
+    renderLeaf.numFaces   = l.n_leafFaces;
+}
+
+
+// create node bounds and parent links used for hierarchical culling
+void Q3BspWorld::CreateRenderNodes()
+{
+    m_renderNodes.resize(nodes.size());
+    m_leafParents.assign(leaves.size(), -1);
+
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        const Q3BspNodeLump &n = nodes[i];
+        Q3NodeRenderable &renderNode = m_renderNodes[i];
+
+        renderNode.mins = Math::Vector3f( n.mins.x / Q3BspWorld::s_worldScale, n.mins.y / Q3BspWorld::s_worldScale, n.mins.z / Q3BspWorld::s_worldScale );
+        renderNode.maxs = Math::Vector3f( n.maxs.x / Q3BspWorld::s_worldScale, n.maxs.y / Q3BspWorld::s_worldScale, n.maxs.z / Q3BspWorld::s_worldScale );
+        renderNode.parent = -1;
+        renderNode.pvsStamp = 0;
+    }
+
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        const int children[2] = { nodes[i].children.x, nodes[i].children.y };
+
+        for (int c = 0; c < 2; ++c)
+        {
+            if (children[c] >= 0)
+                m_renderNodes[children[c]].parent = i;
+            else
+                m_leafParents[~children[c]] = i;
+        }
+    }
+}
+
+
+// leaf bounding boxes in center/extent form
+void Q3BspWorld::CreateLeafBounds()
+{
+    m_leafBounds.Resize(leaves.size());
+
+    for (size_t i = 0; i < leaves.size(); ++i)
+    {
+        const Q3BspLeafLump &l = leaves[i];
+
+        m_leafBounds.Set(i, Math::Vector3f( l.mins.x / Q3BspWorld::s_worldScale, l.mins.y / Q3BspWorld::s_worldScale, l.mins.z / Q3BspWorld::s_worldScale ),
+                            Math::Vector3f( l.maxs.x / Q3BspWorld::s_worldScale, l.maxs.y / Q3BspWorld::s_worldScale, l.maxs.z / Q3BspWorld::s_worldScale ));
+    }
+}
+
+
+// group leaves by PVS cluster (leaves outside the map have no cluster and are never in the PVS)
+void Q3BspWorld::CreateClusterLeaves()
+{
+    int numClusters = 0;
+
+    for (const auto &l : leaves)
+        numClusters = std::max(numClusters, l.cluster + 1);
+
+    m_clusterLeaves.assign(numClusters, std::vector<int>());
+    m_leafPVSStamps.assign(leaves.size(), 0);
+
+    for (size_t i = 0; i < leaves.size(); ++i)
+    {
+        if (leaves[i].cluster >= 0)
+            m_clusterLeaves[leaves[i].cluster].push_back(i);
+    }
+}
+
+
+// create a Q3Bsp curved surface
+Q3BspPatch *Q3BspWorld::CreatePatch(const Q3BspFaceLump &f) const
+{
+    Q3BspPatch *newPatch = new Q3BspPatch;
+
+    newPatch->textureIdx  = f.texture;
+    newPatch->lightmapIdx = f.lm_index;
+    newPatch->width  = f.size.x;
+    newPatch->height = f.size.y;
+
+    int numPatchesWidth  = ( newPatch->width - 1  ) >> 1;
+    int numPatchesHeight = ( newPatch->height - 1 ) >> 1;
+
+    newPatch->quadraticPatches.resize( numPatchesWidth*numPatchesHeight );
+
+    newPatch->mins = Math::Vector3f( FLT_MAX,  FLT_MAX,  FLT_MAX);
+    newPatch->maxs = Math::Vector3f(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    newPatch->curvatureError = 0.f;
+    newPatch->lod = 0;
+
+    // control points of the surface form a width x height grid of bsp vertices
+    const Q3BspVertexLump *controlGrid = &vertices[f.vertex];
+
+    // generate biquadratic patches (components that make the curved surface)
+    for (int y = 0; y < numPatchesHeight; ++y)
+    {
+        for (int x = 0; x < numPatchesWidth; ++x)
+        {
+            Q3BspBiquadPatch &bq = newPatch->quadraticPatches[ y * numPatchesWidth + x ];
+            bq.SetControlOffset( y * 2 * newPatch->width + x * 2 );
+
+            newPatch->curvatureError = std::max(newPatch->curvatureError, bq.CurvatureError(controlGrid, newPatch->width) / Q3BspWorld::s_worldScale);
+        }
+    }
+
+    // bezier patches lie within the bounds of their control points
+    for (int i = 0; i < f.n_vertexes; ++i)
+    {
+        const vec3f &cp = controlGrid[i].position;
+        Math::Vector3f p(cp.x / Q3BspWorld::s_worldScale, cp.y / Q3BspWorld::s_worldScale, cp.z / Q3BspWorld::s_worldScale);
+
+        newPatch->mins = Math::Vector3f(std::min(newPatch->mins.m_x, p.m_x), std::min(newPatch->mins.m_y, p.m_y), std::min(newPatch->mins.m_z, p.m_z));
+        newPatch->maxs = Math::Vector3f(std::max(newPatch->maxs.m_x, p.m_x), std::max(newPatch->maxs.m_y, p.m_y), std::max(newPatch->maxs.m_z, p.m_z));
+    }
+
+    return newPatch;
+}
+
+
+// hash of the source bsp used to validate the map cache
+unsigned long long Q3BspWorld::ComputeBspHash() const
+{
+    if (m_mappedFile)
+        return Q3BspCache::Hash(m_mappedFile->Data(), m_mappedFile->Size());
+
+    MappedFile bspFile;
+
+    if (!bspFile.Open(m_filename))
+        return 0;
+
+    return Q3BspCache::Hash(bspFile.Data(), bspFile.Size());
+}
+
+
+// restore renderable leaves and patches from map cache (tesselated geometry stays in the cache file)
+bool Q3BspWorld::LoadFromCache(const Q3BspCache &cache)
+{
+    if (cache.LumpSize<Q3LeafRenderable>(CacheLeaves)      != (int)leaves.size() ||
+        cache.LumpSize<Q3BspLightMapLump>(CacheLightmaps)  != (int)lightMaps.size())
+    {
+        return false;
+    }
+
+    for (const auto &f : faces)
+    {
+        if (f.type == FaceTypePatch)
+            m_patches.push_back(CreatePatch(f));
+    }
+
+    CreateRenderFaces();
+
+    // buffer layout is derived from bsp data - cached buffers must match it exactly
+    if (cache.LumpSize<Q3BspVertexLump>(CacheVertices) != m_numMapVertices ||
+        cache.LumpSize<unsigned int>(CacheIndices)     != m_numMapIndices)
+    {
+        for (auto &it : m_patches)
+            delete it;
+
+        m_patches.clear();
+        m_renderFaces.clear();
+        return false;
+    }
+
+    const Q3LeafRenderable *cachedLeaves = cache.Lump<Q3LeafRenderable>(CacheLeaves);
+    m_renderLeaves.assign(cachedLeaves, cachedLeaves + leaves.size());
+
+    return true;
+}
+
+
+// store preprocessed map data in the map cache
+bool Q3BspWorld::WriteCache(const std::string &cacheFilename, unsigned long long bspHash,
+                          const std::vector<Q3BspVertexLump> &mapVertices, const std::vector<unsigned int> &mapIndices) const
+{
+    Q3BspCacheHeader header = {};
+    header.bspHash          = bspHash;
+    header.tesselationLevel = Q3BspWorld::s_tesselationLevel;
+    header.lightmapGamma    = Q3BspWorld::s_lightmapGamma;
+
+    return Q3BspCache::Write(cacheFilename, header, m_renderLeaves, mapVertices, mapIndices, lightMaps);
+}
+
+
+// assign each face and biquad patch its range in map vertex/index buffers
+void Q3BspWorld::CreateRenderFaces()
+{
+    m_renderFaces.resize(faces.size());
+
+    int numVertices = (int)vertices.size();
+    int numIndices  = 0;
+
+    // polygons and meshes index the bsp vertex lump directly
+    for (size_t i = 0; i < faces.size(); ++i)
+    {
+        m_renderFaces[i].type = faces[i].type;
+        m_renderFaces[i].lastVisibleFrame = 0;
+
+        if (faces[i].type == FaceTypePatch)
+            continue;
+
+        m_renderFaces[i].index      = i;
+        m_renderFaces[i].firstIndex = numIndices;
+        m_renderFaces[i].numIndices = faces[i].n_meshverts;
+        numIndices += faces[i].n_meshverts;
+    }
+
+    // control points of every biquad come next, they index the bsp vertices of the patch
+    for (auto &patch : m_patches)
+    {
+        patch->firstControlIndex = numIndices;
+        numIndices += 9 * (int)patch->quadraticPatches.size();
+    }
+
+    m_numControlIndices = numIndices;
+
+    // tesselated patches are appended after bsp vertices and control points - vertices of each biquad are kept together
+    for (auto &patch : m_patches)
+    {
+        for (auto &bq : patch->quadraticPatches)
+        {
+            bq.SetBufferRange(Q3BspWorld::s_patchLodLevels, numVertices);
+            numVertices += bq.NumVertices();
+        }
+    }
+
+    // strips of a patch LOD form one contiguous range, and patches follow each other within a LOD -
+    // primitive restart terminates every strip, so neighbouring patches at the same LOD merge into one draw range
+    for (int lod = 0; lod < Q3BspBiquadPatch::s_numLods; ++lod)
+    {
+        for (auto &patch : m_patches)
+        {
+            patch->firstIndex[lod] = numIndices;
+
+            for (auto &bq : patch->quadraticPatches)
+            {
+                bq.SetIndexRange(lod, numIndices);
+                numIndices += bq.NumIndices(lod);
+            }
+
+            patch->numIndices[lod] = numIndices - patch->firstIndex[lod];
+        }
+    }
+
+    int patchIdx = 0;
+
+    for (size_t i = 0; i < faces.size(); ++i)
+    {
+        if (faces[i].type != FaceTypePatch)
+            continue;
+
+        m_renderFaces[i].index      = patchIdx;
+        m_renderFaces[i].firstIndex = m_patches[patchIdx]->firstIndex[0];
+        m_renderFaces[i].numIndices = m_patches[patchIdx]->numIndices[0];
+        ++patchIdx;
+    }
+
+    m_numMapVertices = numVertices;
+    m_numMapIndices  = numIndices;
+}
+
+
+// fill map vertex/index buffers using the layout from CreateRenderFaces()
+void Q3BspWorld::BuildGeometry(std::vector<Q3BspVertexLump> &mapVertices, std::vector<unsigned int> &mapIndices)
+{
+    mapVertices.resize(m_numMapVertices);
+    mapIndices.resize(m_numMapIndices);
+
+    std::copy(vertices.begin(), vertices.end(), mapVertices.begin());
+
+    ThreadPool::GetInstance()->ParallelFor((int)faces.size(), [this, &mapVertices, &mapIndices](int i)
+    {
+        const Q3BspFaceLump    &f  = faces[i];
+        const Q3FaceRenderable &rf = m_renderFaces[i];
+
+        if (f.type == FaceTypePatch)
+        {
+            const Q3BspPatch *patch = m_patches[rf.index];
+            patch->Tesselate(&vertices[f.vertex], mapVertices.data(), mapIndices.data());
+
+            for (size_t j = 0; j < patch->quadraticPatches.size(); ++j)
+            {
+                const Q3BspBiquadPatch &bq = patch->quadraticPatches[j];
+
+                for (int k = bq.FirstVertex(); k < bq.FirstVertex() + bq.NumVertices(); ++k)
+                    AtlasLightmapCoords(mapVertices[k], mapVertices[k], f.lm_index);
+
+                for (int cp = 0; cp < 9; ++cp)
+                    mapIndices[patch->firstControlIndex + j * 9 + cp] = f.vertex + bq.ControlIndex(cp, patch->width);
+            }
+        }
+        else
+        {
+            // mesh vertex offsets are relative to the first vertex of the face
+            for (int j = 0; j < f.n_meshverts; ++j)
+                mapIndices[rf.firstIndex + j] = f.vertex + meshVertices[f.meshvert + j].offset;
+        }
+
+        // bsp vertices are remapped from the source lump, so vertices shared between faces stay correct
+        // (patch control points are rendered directly by GPU tesselation)
+        for (int j = f.vertex; j < f.vertex + f.n_vertexes; ++j)
+            AtlasLightmapCoords(mapVertices[j], vertices[j], f.lm_index);
+    });
+}
+
+
+// smallest power of 2 tile count (up to s_maxAtlasTiles) that fits all lightmaps on one atlas page
+int Q3BspWorld::AtlasTiles() const
+{
+    int tiles = 1;
+
+    while (tiles < s_maxAtlasTiles && tiles * tiles < (int)lightMaps.size())
+        tiles *= 2;
+
+    return tiles;
+}
+
+
+int Q3BspWorld::NumAtlasPages() const
+{
+    int tilesPerPage = AtlasTiles() * AtlasTiles();
+
+    return ((int)lightMaps.size() + tilesPerPage - 1) / tilesPerPage;
+}
+
+
+// transform lightmap coordinates of a face vertex into its tile on the atlas page (inset by the gutter)
+void Q3BspWorld::AtlasLightmapCoords(Q3BspVertexLump &vertex, const Q3BspVertexLump &source, int lightmapIdx) const
+{
+    // faces without a lightmap use a white texture - coordinates don't matter
+    if (lightmapIdx < 0)
+        return;
+
+    int   tiles     = AtlasTiles();
+    int   tile      = lightmapIdx % (tiles * tiles);
+    float atlasSize = (float)(tiles * AtlasTileSize());
+
+    vertex.texcoord[1].x = ((tile % tiles) * AtlasTileSize() + s_lightmapGutter + source.texcoord[1].x * s_lightmapSize) / atlasSize;
+    vertex.texcoord[1].y = ((tile / tiles) * AtlasTileSize() + s_lightmapGutter + source.texcoord[1].y * s_lightmapSize) / atlasSize;
+}
\ No newline at end of file
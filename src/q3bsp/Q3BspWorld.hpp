@@ -0,0 +1,147 @@
+#ifndef Q3BSPWORLD_INCLUDED
+#define Q3BSPWORLD_INCLUDED
+
+#include "Frustum.hpp"
+#include "common/BspMap.hpp"
+#include "q3bsp/Q3Bsp.hpp"
+#include "q3bsp/Q3BspLumpSpan.hpp"
+#include <vector>
+#include <string>
+
+class  MappedFile;
+class  Q3BspCache;
+struct Q3BspPatch;
+
+/*
+ *  Quake III map data and visibility (PVS + frustum culling) without any rendering.
+ *  Usable on its own for headless processing, Q3BspMap adds the GL side on top.
+ */
+
+class Q3BspWorld : public BspMap
+{
+public:
+    friend class Q3BspLoader;
+
+    static const int   s_tesselationLevel; // level of curved surface tesselation
+    static const int   s_patchLodLevels[]; // tesselation level of each curved surface LOD (finest is s_tesselationLevel)
+    static const float s_patchLodError;    // max projected curved surface error allowed by LOD selection (radians)
+    static const float s_worldScale;       // scale down factor for the map
+    static const float s_lightmapGamma;    // lightmap brightness boost
+    static const int   s_lightmapSize;     // width/height of a bsp lightmap
+    static const int   s_lightmapGutter;   // replicated border around each lightmap on the atlas (texels)
+    static const int   s_lightmapMaxLevel; // last lightmap atlas mip level - the gutter keeps it free of neighbour bleeding
+    static const int   s_maxAtlasTiles;    // max lightmaps per lightmap atlas row/column
+
+    Q3BspWorld() : BspMap(), m_visibleFrame(0), m_cameraLeaf(0), m_pvsCluster(-2), m_pvsStamp(0), m_numMapVertices(0), m_numMapIndices(0), m_numControlIndices(0), m_mappedFile(NULL)
+    {
+        // freed by the destructor even if loading fails before the lumps are read
+        entities.ents = NULL;
+        visData.vecs  = NULL;
+    }
+
+    virtual ~Q3BspWorld();
+
+    // CPU-only map setup - no rendering hooks
+    virtual void Init();
+    virtual void OnFrameStart()   {}
+    virtual void OnRenderStart()  {}
+    virtual void Render()         {}
+    virtual void OnRenderFinish() {}
+
+    bool ClusterVisible(int cameraCluster, int testCluster)   const;
+    int  FindCameraLeaf(const Math::Vector3f &cameraPosition) const;
+    void CalculateVisibleFaces(const Math::Vector3f &cameraPosition, const Math::Matrix4f &cullingMatrix);
+    void UpdatePVS(int cameraCluster);
+    void AddVisibleLeafFaces(const Q3LeafRenderable &renderLeaf);
+    void SelectPatchLods(const Math::Vector3f &cameraPosition);
+
+    const std::vector<Q3FaceRenderable *> &VisibleFaces() const { return m_visibleFaces; }
+    int CameraLeaf() const { return m_cameraLeaf; }  // leaf found by the last CalculateVisibleFaces
+
+    // lightmaps are packed into square atlas pages of AtlasTiles() x AtlasTiles() tiles of AtlasTileSize() texels
+    // (lightmap plus gutter), map vertex lightmap coordinates address the atlas page of their face
+    static int AtlasTileSize() { return s_lightmapSize + 2 * s_lightmapGutter; }
+    int AtlasTiles() const;
+    int NumAtlasPages() const;
+    int AtlasPage(int lightmapIdx) const { return lightmapIdx < 0 ? -1 : lightmapIdx / (AtlasTiles() * AtlasTiles()); }
+
+    // bsp data
+    Q3BspHeader     header;
+    Q3BspEntityLump entities;
+    std::vector<Q3BspTextureLump>   textures;
+    Q3BspLumpSpan<Q3BspPlaneLump>   planes;
+    Q3BspLumpSpan<Q3BspNodeLump>    nodes;
+    Q3BspLumpSpan<Q3BspLeafLump>    leaves;
+    std::vector<Q3BspLeafFaceLump>  leafFaces;
+    std::vector<Q3BspLeafBrushLump> leafBrushes;
+    std::vector<Q3BspModelLump>     models;
+    std::vector<Q3BspBrushLump>     brushes;
+    std::vector<Q3BspBrushSideLump> brushSides;
+    Q3BspLumpSpan<Q3BspVertexLump>   vertices;
+    Q3BspLumpSpan<Q3BspMeshVertLump> meshVertices;
+    std::vector<Q3BspEffectLump>    effects;
+    Q3BspLumpSpan<Q3BspFaceLump>    faces;
+    std::vector<Q3BspLightMapLump>  lightMaps;
+    std::vector<Q3BspLightVolLump>  lightVols;
+    Q3BspVisDataLump                visData;
+
+protected:
+    // stage 1 of map loading: restore from the .bspc cache or preprocess (and bake) bsp data on worker threads;
+    // map vertex/index buffers are only filled if the cache couldn't be used
+    void Preprocess(Q3BspCache &cache, std::vector<Q3BspVertexLump> &mapVertices, std::vector<unsigned int> &mapIndices);
+
+    // CPU-only load stages (executed on worker threads)
+    void SetLightmapGamma(Q3BspLightMapLump &lightMap, float gamma);
+    void CreateRenderLeaf(const Q3BspLeafLump &l, Q3LeafRenderable &renderLeaf) const;
+    void CreateRenderNodes();
+    void CreateClusterLeaves();
+    void CreateLeafBounds();
+    Q3BspPatch *CreatePatch(const Q3BspFaceLump &f) const;
+
+    // render-ready map cache (.bspc)
+    unsigned long long ComputeBspHash() const;
+    bool LoadFromCache(const Q3BspCache &cache);
+    bool WriteCache(const std::string &cacheFilename, unsigned long long bspHash,
+                    const std::vector<Q3BspVertexLump> &mapVertices, const std::vector<unsigned int> &mapIndices) const;
+
+    // map-wide vertex/index buffer layout and contents
+    void CreateRenderFaces();
+    void BuildGeometry(std::vector<Q3BspVertexLump> &mapVertices, std::vector<unsigned int> &mapIndices);
+    void AtlasLightmapCoords(Q3BspVertexLump &vertex, const Q3BspVertexLump &source, int lightmapIdx) const;
+
+    // culling data
+    std::vector<Q3LeafRenderable>   m_renderLeaves; // bsp leaves in "renderable format"
+    std::vector<Q3NodeRenderable>   m_renderNodes;  // bsp nodes in "renderable format"
+    std::vector<int>                m_leafParents;  // parent node of each leaf
+    BoxListSoA                      m_leafBounds;   // leaf bounding boxes for batched frustum culling
+    std::vector<int>                m_cullLeaves;   // leaves waiting for frustum test
+    std::vector<unsigned char>      m_cullResults;
+    std::vector< std::pair<int, bool> > m_nodeStack; // bsp traversal stack (node/leaf index, inside frustum)
+    std::vector<Q3FaceRenderable>   m_renderFaces;  // bsp faces in "renderable format"
+
+    std::vector<Q3BspPatch *>       m_patches;      // curved surfaces
+    std::vector<Q3FaceRenderable *> m_visibleFaces; // list of visible surfaces to render
+    unsigned int m_visibleFrame;                    // visible set counter (see Q3FaceRenderable::lastVisibleFrame)
+    int          m_cameraLeaf;                      // bsp leaf containing the camera of the current visible set
+
+    // PVS of the current camera cluster, rebuilt only when the camera changes clusters
+    std::vector< std::vector<int> > m_clusterLeaves; // leaves belonging to each cluster
+    std::vector<unsigned int>       m_leafPVSStamps; // leaf is in the PVS if its stamp equals m_pvsStamp
+    int          m_pvsCluster;                      // cluster the PVS was built for (-2 if none)
+    unsigned int m_pvsStamp;
+
+    Frustum  m_frustum;                             // view frustum
+    Math::Vector3f m_cameraPosition;                // camera position of the current visible set (viewer units)
+
+    // map-wide vertex/index buffer sizes (see CreateRenderFaces)
+    int m_numMapVertices;    // bsp vertices followed by tesselated patch vertices
+    int m_numMapIndices;     // face mesh vertices (absolute), patch control points and patch triangle strips
+    int m_numControlIndices; // face mesh vertices and patch control points only (enough for GPU tesselation)
+
+    // bsp file backing the lump spans (NULL if the map was loaded into vectors)
+    MappedFile *m_mappedFile;
+    std::string m_filename;
+};
+
+
+#endif
\ No newline at end of file
@@ -35,6 +35,10 @@ public:
     void SetMode(CameraMode cm);
     CameraMode GetMode() { return m_mode; }
     const Math::Vector3f &Position() const { return m_position; }
+    const Math::Vector3f &ViewVector()  const { return m_viewVector; }
+    const Math::Vector3f &UpVector()    const { return m_upVector; }
+    const Math::Vector3f &RightVector() const { return m_rightVector; }
+    void SetPosition(const Math::Vector3f &position) { m_position = position; }
 
     // rotate in Euler-space - used mainly for some debugging
     void rotateX(float angle);
@@ -0,0 +1,440 @@
+#include "renderer/CompressedTexture.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+static const int  s_cacheVersion   = 1;
+static const char s_cacheMagic[4]  = { 'B', 'C', 'T', 'X' };
+static const int  s_maxCacheSize   = 16384;  // largest width/height accepted from a cache file
+
+// on-disk cache header, followed by the compressed mip levels
+struct CompressedTextureHeader
+{
+    char               magic[4];
+    int                version;
+    unsigned long long sourceHash;   // hash of the source image file
+    int                width;
+    int                height;
+    GLenum             format;
+    int                numLevels;
+};
+
+
+static unsigned short PackRGB565(const float *color)
+{
+    int r = std::min(31, std::max(0, (int)(color[0] * 31.f / 255.f + 0.5f)));
+    int g = std::min(63, std::max(0, (int)(color[1] * 63.f / 255.f + 0.5f)));
+    int b = std::min(31, std::max(0, (int)(color[2] * 31.f / 255.f + 0.5f)));
+
+    return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+
+static void UnpackRGB565(unsigned short packed, int *color)
+{
+    color[0] = ((packed >> 11) & 31) * 255 / 31;
+    color[1] = ((packed >> 5)  & 63) * 255 / 63;
+    color[2] = ( packed        & 31) * 255 / 31;
+}
+
+
+// BC1 color block: endpoints at the extremes of the block's principal axis, 4-color mode
+static void EncodeColorBlock(const unsigned char block[16][4], unsigned char *output)
+{
+    float mean[3] = { 0.f, 0.f, 0.f };
+
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int c = 0; c < 3; ++c)
+            mean[c] += block[i][c] / 16.f;
+    }
+
+    float cov[6] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };   // rr, rg, rb, gg, gb, bb
+
+    for (int i = 0; i < 16; ++i)
+    {
+        float r = block[i][0] - mean[0];
+        float g = block[i][1] - mean[1];
+        float b = block[i][2] - mean[2];
+
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+
+    // principal axis by power iteration
+    float axis[3] = { 1.f, 1.f, 1.f };
+
+    for (int iter = 0; iter < 4; ++iter)
+    {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float length = std::max(std::max(fabsf(x), fabsf(y)), fabsf(z));
+
+        if (length < 1e-6f)
+            break;
+
+        axis[0] = x / length;
+        axis[1] = y / length;
+        axis[2] = z / length;
+    }
+
+    float minProj = 1e30f, maxProj = -1e30f;
+    int   minIdx  = 0,     maxIdx  = 0;
+
+    for (int i = 0; i < 16; ++i)
+    {
+        float proj = block[i][0] * axis[0] + block[i][1] * axis[1] + block[i][2] * axis[2];
+
+        if (proj < minProj) { minProj = proj; minIdx = i; }
+        if (proj > maxProj) { maxProj = proj; maxIdx = i; }
+    }
+
+    float maxColor[3] = { (float)block[maxIdx][0], (float)block[maxIdx][1], (float)block[maxIdx][2] };
+    float minColor[3] = { (float)block[minIdx][0], (float)block[minIdx][1], (float)block[minIdx][2] };
+
+    unsigned short color0 = PackRGB565(maxColor);
+    unsigned short color1 = PackRGB565(minColor);
+
+    // color0 > color1 selects 4-color mode
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    unsigned int indices = 0;
+
+    if (color0 != color1)
+    {
+        int palette[4][3];
+        UnpackRGB565(color0, palette[0]);
+        UnpackRGB565(color1, palette[1]);
+
+        for (int c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 0; i < 16; ++i)
+        {
+            int bestIdx  = 0;
+            int bestDist = 0x7fffffff;
+
+            for (int p = 0; p < 4; ++p)
+            {
+                int dr = block[i][0] - palette[p][0];
+                int dg = block[i][1] - palette[p][1];
+                int db = block[i][2] - palette[p][2];
+                int dist = dr * dr + dg * dg + db * db;
+
+                if (dist < bestDist)
+                {
+                    bestDist = dist;
+                    bestIdx  = p;
+                }
+            }
+
+            indices |= bestIdx << (2 * i);
+        }
+    }
+
+    output[0] = color0 & 0xff;
+    output[1] = color0 >> 8;
+    output[2] = color1 & 0xff;
+    output[3] = color1 >> 8;
+    memcpy(output + 4, &indices, 4);
+}
+
+
+// BC3 alpha block: min/max endpoints, 8-value mode
+static void EncodeAlphaBlock(const unsigned char block[16][4], unsigned char *output)
+{
+    int alpha0 = 0, alpha1 = 255;
+
+    for (int i = 0; i < 16; ++i)
+    {
+        alpha0 = std::max(alpha0, (int)block[i][3]);
+        alpha1 = std::min(alpha1, (int)block[i][3]);
+    }
+
+    unsigned long long indices = 0;
+
+    if (alpha0 != alpha1)
+    {
+        int palette[8] = { alpha0, alpha1 };
+
+        for (int p = 1; p < 7; ++p)
+            palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            int bestIdx  = 0;
+            int bestDist = 256;
+
+            for (int p = 0; p < 8; ++p)
+            {
+                int dist = abs(block[i][3] - palette[p]);
+
+                if (dist < bestDist)
+                {
+                    bestDist = dist;
+                    bestIdx  = p;
+                }
+            }
+
+            indices |= (unsigned long long)bestIdx << (3 * i);
+        }
+    }
+
+    output[0] = (unsigned char)alpha0;
+    output[1] = (unsigned char)alpha1;
+
+    for (int i = 0; i < 6; ++i)
+        output[2 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+
+CompressedTexture *CompressedTexture::Compress(const unsigned char *pixels, int width, int height, int components)
+{
+    if (!pixels || width <= 0 || height <= 0 || components < 1 || components > 4)
+        return NULL;
+
+    CompressedTexture *texture = new CompressedTexture;
+    texture->m_width  = width;
+    texture->m_height = height;
+
+    MipChain levels;
+    bool hasAlpha = BuildMipChain(pixels, width, height, components, levels);
+
+    texture->m_format = hasAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+    int levelWidth  = width;
+    int levelHeight = height;
+    int numLevels   = (int)levels.size();
+    int blockSize   = hasAlpha ? 16 : 8;
+
+    texture->m_levels.resize(numLevels);
+
+    for (int l = 0; l < numLevels; ++l)
+    {
+        const std::vector<unsigned char> &level = levels[l];
+        int blocksX = (levelWidth  + 3) / 4;
+        int blocksY = (levelHeight + 3) / 4;
+        std::vector<unsigned char> &output = texture->m_levels[l];
+        output.resize(blocksX * blocksY * blockSize);
+
+        for (int by = 0; by < blocksY; ++by)
+        {
+            for (int bx = 0; bx < blocksX; ++bx)
+            {
+                // levels smaller than a block repeat their edge pixels
+                unsigned char block[16][4];
+
+                for (int y = 0; y < 4; ++y)
+                {
+                    for (int x = 0; x < 4; ++x)
+                    {
+                        int px = std::min(bx * 4 + x, levelWidth  - 1);
+                        int py = std::min(by * 4 + y, levelHeight - 1);
+                        memcpy(block[y * 4 + x], &level[(py * levelWidth + px) * 4], 4);
+                    }
+                }
+
+                unsigned char *blockOutput = &output[(by * blocksX + bx) * blockSize];
+
+                if (hasAlpha)
+                {
+                    EncodeAlphaBlock(block, blockOutput);
+                    EncodeColorBlock(block, blockOutput + 8);
+                }
+                else
+                {
+                    EncodeColorBlock(block, blockOutput);
+                }
+            }
+        }
+
+        levelWidth  = std::max(1, levelWidth  / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+
+    return texture;
+}
+
+
+bool CompressedTexture::BuildMipChain(const unsigned char *pixels, int width, int height, int components, MipChain &levels)
+{
+    int numLevels = NumMipLevels(width, height);
+    levels.resize(numLevels);
+
+    // expand to RGBA and check for transparency
+    std::vector<unsigned char> &baseLevel = levels[0];
+    baseLevel.resize(width * height * 4);
+    bool hasAlpha = false;
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        const unsigned char *src = pixels + i * components;
+        unsigned char *dst = &baseLevel[i * 4];
+
+        dst[0] = src[0];
+        dst[1] = components >= 3 ? src[1] : src[0];
+        dst[2] = components >= 3 ? src[2] : src[0];
+        dst[3] = components == 4 ? src[3] : (components == 2 ? src[1] : 255);
+
+        hasAlpha |= dst[3] != 255;
+    }
+
+    int levelWidth  = width;
+    int levelHeight = height;
+
+    for (int l = 1; l < numLevels; ++l)
+    {
+        // 2x2 box filter of the previous level
+        const std::vector<unsigned char> &level = levels[l - 1];
+        int nextWidth  = std::max(1, levelWidth  / 2);
+        int nextHeight = std::max(1, levelHeight / 2);
+        std::vector<unsigned char> &nextLevel = levels[l];
+        nextLevel.resize(nextWidth * nextHeight * 4);
+
+        for (int y = 0; y < nextHeight; ++y)
+        {
+            for (int x = 0; x < nextWidth; ++x)
+            {
+                int x0 = std::min(2 * x, levelWidth - 1),  x1 = std::min(2 * x + 1, levelWidth - 1);
+                int y0 = std::min(2 * y, levelHeight - 1), y1 = std::min(2 * y + 1, levelHeight - 1);
+
+                for (int c = 0; c < 4; ++c)
+                {
+                    nextLevel[(y * nextWidth + x) * 4 + c] = (unsigned char)((level[(y0 * levelWidth + x0) * 4 + c] + level[(y0 * levelWidth + x1) * 4 + c] +
+                                                                              level[(y1 * levelWidth + x0) * 4 + c] + level[(y1 * levelWidth + x1) * 4 + c] + 2) / 4);
+                }
+            }
+        }
+
+        levelWidth  = nextWidth;
+        levelHeight = nextHeight;
+    }
+
+    return hasAlpha;
+}
+
+
+CompressedTexture *CompressedTexture::LoadCache(const std::string &filename, unsigned long long sourceHash)
+{
+    std::ifstream cacheFile(filename, std::ios::in | std::ios::binary);
+
+    if (!cacheFile.is_open())
+        return NULL;
+
+    CompressedTextureHeader header;
+    cacheFile.read((char *)&header, sizeof(header));
+
+    // stale or foreign cache - needs rebuilding
+    if (!cacheFile || memcmp(header.magic, s_cacheMagic, 4) || header.version != s_cacheVersion || header.sourceHash != sourceHash)
+        return NULL;
+
+    // corrupt header - don't trust it for allocations
+    if ((header.format != GL_COMPRESSED_RGB_S3TC_DXT1_EXT && header.format != GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) ||
+        header.width  <= 0 || header.width  > s_maxCacheSize ||
+        header.height <= 0 || header.height > s_maxCacheSize ||
+        header.numLevels != NumMipLevels(header.width, header.height))
+    {
+        return NULL;
+    }
+
+    // file could have been truncated while being written
+    size_t dataSize    = 0;
+    int    levelWidth  = header.width;
+    int    levelHeight = header.height;
+
+    for (int level = 0; level < header.numLevels; ++level)
+    {
+        dataSize += LevelSize(header.format, levelWidth, levelHeight);
+
+        levelWidth  = std::max(1, levelWidth  / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+
+    cacheFile.seekg(0, std::ios::end);
+
+    if ((size_t)cacheFile.tellg() != sizeof(header) + dataSize)
+        return NULL;
+
+    cacheFile.seekg(sizeof(header), std::ios::beg);
+
+    CompressedTexture *texture = new CompressedTexture;
+    texture->m_width  = header.width;
+    texture->m_height = header.height;
+    texture->m_format = header.format;
+    texture->m_levels.resize(header.numLevels);
+
+    levelWidth  = header.width;
+    levelHeight = header.height;
+
+    for (auto &level : texture->m_levels)
+    {
+        level.resize(LevelSize(header.format, levelWidth, levelHeight));
+        cacheFile.read((char *)level.data(), level.size());
+
+        levelWidth  = std::max(1, levelWidth  / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+
+    if (!cacheFile)
+    {
+        delete texture;
+        return NULL;
+    }
+
+    return texture;
+}
+
+
+bool CompressedTexture::WriteCache(const std::string &filename, unsigned long long sourceHash) const
+{
+    std::ofstream cacheFile(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (!cacheFile.is_open())
+        return false;
+
+    CompressedTextureHeader header;
+    memcpy(header.magic, s_cacheMagic, 4);
+    header.version    = s_cacheVersion;
+    header.sourceHash = sourceHash;
+    header.width      = m_width;
+    header.height     = m_height;
+    header.format     = m_format;
+    header.numLevels  = NumLevels();
+
+    cacheFile.write((const char *)&header, sizeof(header));
+
+    for (const auto &level : m_levels)
+        cacheFile.write((const char *)level.data(), level.size());
+
+    return cacheFile.good();
+}
+
+
+int CompressedTexture::NumMipLevels(int width, int height)
+{
+    int numLevels = 1;
+
+    while (width > 1 || height > 1)
+    {
+        width  = std::max(1, width  / 2);
+        height = std::max(1, height / 2);
+        numLevels++;
+    }
+
+    return numLevels;
+}
+
+
+int CompressedTexture::LevelSize(GLenum format, int width, int height)
+{
+    int blockSize = format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16;
+
+    return ((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+}
\ No newline at end of file
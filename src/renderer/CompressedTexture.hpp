@@ -0,0 +1,47 @@
+#ifndef COMPRESSEDTEXTURE_INCLUDED
+#define COMPRESSEDTEXTURE_INCLUDED
+
+#include "renderer/OpenGL.hpp"
+#include <string>
+#include <vector>
+
+/*
+ *  Block compressed texture (BC1 if opaque, BC3 with alpha) with a full mip chain, encoded on the CPU.
+ *  GL-free apart from format enums - safe to create on worker threads.
+ */
+
+class CompressedTexture
+{
+public:
+    typedef std::vector< std::vector<unsigned char> > MipChain;
+
+    // build the mip chain and compress all levels
+    static CompressedTexture *Compress(const unsigned char *pixels, int width, int height, int components);
+    // expand pixels to RGBA and box filter them down to 1x1 (all levels RGBA8), returns true if any pixel is transparent
+    static bool BuildMipChain(const unsigned char *pixels, int width, int height, int components, MipChain &levels);
+
+    // on-disk transcoding cache, valid only for the source file it was created from
+    static CompressedTexture *LoadCache(const std::string &filename, unsigned long long sourceHash);
+    bool WriteCache(const std::string &filename, unsigned long long sourceHash) const;
+
+    static int NumMipLevels(int width, int height);
+    static int LevelSize(GLenum format, int width, int height);  // bytes of a compressed width x height image
+
+    int    Width()     const { return m_width; }
+    int    Height()    const { return m_height; }
+    GLenum Format()    const { return m_format; }
+    int    NumLevels() const { return (int)m_levels.size(); }
+    const std::vector<unsigned char> &Level(int level) const { return m_levels[level]; }
+
+private:
+    CompressedTexture() : m_width(0), m_height(0), m_format(0)
+    {
+    }
+
+    int    m_width;
+    int    m_height;
+    GLenum m_format;
+    std::vector< std::vector<unsigned char> > m_levels;
+};
+
+#endif
\ No newline at end of file
@@ -62,7 +62,9 @@ Font::~Font()
 
 void Font::renderAt(const Math::Vector3f &pos, int w, int h, int uo, int vo, const Math::Vector4f &color)
 {
-    LOG_MESSAGE_ASSERT(m_texture != NULL, "Trying to render with no texture?");
+    LOG_MESSAGE_ASSERT(m_texture != InvalidTextureHandle, "Trying to render with no texture?");
+
+    const Texture *texture = TextureManager::GetInstance()->GetTexture(m_texture);
 
     Math::Matrix4f texMatrix, mvMatrix;
 
@@ -70,7 +72,7 @@ void Font::renderAt(const Math::Vector3f &pos, int w, int h, int uo, int vo, con
     Math::Scale(mvMatrix, 2.f * w / g_renderContext.height, 2.f * h / g_renderContext.height);
     Math::Scale(mvMatrix, m_scale.m_x, m_scale.m_y);
 
-    Math::Scale(texMatrix, 1.f / m_texture->Width(), -1.f / m_texture->Height());
+    Math::Scale(texMatrix, 1.f / texture->Width(), -1.f / texture->Height());
     Math::Translate(texMatrix, (float)uo, (float)-vo);
     Math::Scale(texMatrix, (float)w, (float)h);
 
@@ -2,10 +2,9 @@
 #define FONT_HPP
 
 #include "renderer/OpenGL.hpp"
+#include "renderer/TextureManager.hpp"
 #include <string>
 
-class Texture;
-
 class Font
 {
 public:
@@ -20,7 +19,7 @@ public:
     void drawText(const std::string &text, float x, float y, float z=-1.0f);
 private:
     void renderAt(const Math::Vector3f &pos, int w, int h, int uo, int vo, const Math::Vector4f &color);
-    Texture*        m_texture;
+    TextureHandle   m_texture;
     Math::Vector2f  m_scale;
     Math::Vector3f  m_position;
     Math::Vector4f  m_color;
@@ -0,0 +1,247 @@
+#include "renderer/FrameProfiler.hpp"
+#include <algorithm>
+
+static const char *s_zoneNames[NumProfileZones]   = { "update", "visible set", "render", "stats UI", "swap" };
+static const char *s_csvZoneNames[NumProfileZones] = { "update", "visible_set", "render", "stats_ui", "swap" };
+
+FrameProfiler* FrameProfiler::GetInstance()
+{
+    static FrameProfiler instance;
+    return &instance;
+}
+
+
+void FrameProfiler::Init()
+{
+    glGenQueries(2 * NumProfileZones * s_maxQueries, &m_queries[0][0][0]);
+    m_frameTimer.Reset();
+    m_initialized = true;
+}
+
+
+void FrameProfiler::Destroy()
+{
+    StopCsvCapture();
+
+    if (m_initialized)
+        glDeleteQueries(2 * NumProfileZones * s_maxQueries, &m_queries[0][0][0]);
+
+    m_initialized = false;
+}
+
+
+void FrameProfiler::BeginGpu(ProfileZone zone)
+{
+    // only one GL_TIME_ELAPSED query may be active at a time - GPU zones must not nest
+    if (!m_initialized || m_numQueries[m_queryBuffer][zone] == s_maxQueries)
+        return;
+
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[m_queryBuffer][zone][m_numQueries[m_queryBuffer][zone]]);
+    m_queryActive[zone] = true;
+}
+
+
+void FrameProfiler::EndGpu(ProfileZone zone)
+{
+    if (!m_queryActive[zone])
+        return;
+
+    glEndQuery(GL_TIME_ELAPSED);
+    m_queryActive[zone] = false;
+    m_numQueries[m_queryBuffer][zone]++;
+}
+
+
+void FrameProfiler::EndFrame()
+{
+    FrameSample &sample = m_history[m_numFrames % s_historySize];
+
+    sample.frameTime = (float)m_frameTimer.ElapsedMs();
+    m_frameTimer.Reset();
+
+    for (int i = 0; i < NumProfileZones; ++i)
+    {
+        sample.cpuTime[i] = m_cpuAccum[i];
+        sample.gpuTime[i] = -1.f;
+        m_cpuAccum[i]     = 0.f;
+    }
+
+    // collect GPU times of the previous frame - its queries had a whole frame to finish,
+    // results that are still not available are dropped rather than waited for
+    int prevBuffer = m_queryBuffer ^ 1;
+
+    if (m_initialized && m_numFrames > 0)
+    {
+        FrameSample &prevSample = m_history[(m_numFrames - 1) % s_historySize];
+
+        for (int i = 0; i < NumProfileZones; ++i)
+        {
+            GLuint64 totalTime = 0;
+            bool     complete  = true;
+
+            for (int q = 0; q < m_numQueries[prevBuffer][i]; ++q)
+            {
+                GLint available = 0;
+                glGetQueryObjectiv(m_queries[prevBuffer][i][q], GL_QUERY_RESULT_AVAILABLE, &available);
+
+                if (!available)
+                {
+                    complete = false;
+                    break;
+                }
+
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(m_queries[prevBuffer][i][q], GL_QUERY_RESULT, &elapsed);
+                totalTime += elapsed;
+            }
+
+            prevSample.gpuTime[i] = complete ? (float)(totalTime / 1000000.0) : -1.f;
+        }
+
+        if (m_csvFile.is_open())
+            WriteCsvLine(m_numFrames - 1, prevSample);
+    }
+
+    // next frame reuses the query buffer that was just read
+    for (int i = 0; i < NumProfileZones; ++i)
+        m_numQueries[prevBuffer][i] = 0;
+
+    m_queryBuffer = prevBuffer;
+    m_numFrames++;
+}
+
+
+bool FrameProfiler::StartCsvCapture(const std::string &filename)
+{
+    StopCsvCapture();
+
+    m_csvFile.open(filename, std::ios::out | std::ios::trunc);
+
+    if (!m_csvFile.is_open())
+        return false;
+
+    m_csvFile << "frame,frame_ms";
+
+    for (int i = 0; i < NumProfileZones; ++i)
+        m_csvFile << ",cpu_" << s_csvZoneNames[i] << "_ms";
+
+    for (int i = 0; i < NumProfileZones; ++i)
+    {
+        if (ZoneHasGpuTimer((ProfileZone)i))
+            m_csvFile << ",gpu_" << s_csvZoneNames[i] << "_ms";
+    }
+
+    m_csvFile << "\n";
+
+    return true;
+}
+
+
+void FrameProfiler::StopCsvCapture()
+{
+    if (m_csvFile.is_open())
+        m_csvFile.close();
+}
+
+
+float FrameProfiler::GpuFrameTime(int age) const
+{
+    const FrameSample &sample = History(age);
+    float total = 0.f;
+
+    for (int i = 0; i < NumProfileZones; ++i)
+    {
+        if (sample.gpuTime[i] < 0.f && ZoneHasGpuTimer((ProfileZone)i))
+            return -1.f;
+
+        if (sample.gpuTime[i] > 0.f)
+            total += sample.gpuTime[i];
+    }
+
+    return total;
+}
+
+
+ProfileSummary FrameProfiler::FrameSummary() const
+{
+    float values[s_historySize];
+    int count = 0;
+
+    for (int age = 0; age < NumFrames(); ++age)
+        values[count++] = FrameTime(age);
+
+    return Summarize(values, count);
+}
+
+
+ProfileSummary FrameProfiler::CpuSummary(ProfileZone zone) const
+{
+    float values[s_historySize];
+    int count = 0;
+
+    for (int age = 0; age < NumFrames(); ++age)
+        values[count++] = CpuTime(zone, age);
+
+    return Summarize(values, count);
+}
+
+
+ProfileSummary FrameProfiler::GpuSummary(ProfileZone zone) const
+{
+    float values[s_historySize];
+    int count = 0;
+
+    for (int age = 0; age < NumFrames(); ++age)
+    {
+        if (GpuTime(zone, age) >= 0.f)
+            values[count++] = GpuTime(zone, age);
+    }
+
+    return Summarize(values, count);
+}
+
+
+const char *FrameProfiler::ZoneName(ProfileZone zone)
+{
+    return s_zoneNames[zone];
+}
+
+
+ProfileSummary FrameProfiler::Summarize(float *values, int count) const
+{
+    ProfileSummary summary = { 0.f, 0.f, 0.f };
+
+    if (count == 0)
+        return summary;
+
+    float total = 0.f;
+
+    for (int i = 0; i < count; ++i)
+        total += values[i];
+
+    int p99Idx = std::min(count - 1, (int)(count * 0.99f));
+    std::nth_element(values, values + p99Idx, values + count);
+
+    summary.p99Time = values[p99Idx];
+    summary.minTime = *std::min_element(values, values + count);
+    summary.avgTime = total / count;
+
+    return summary;
+}
+
+
+void FrameProfiler::WriteCsvLine(int frame, const FrameSample &sample)
+{
+    m_csvFile << frame << "," << sample.frameTime;
+
+    for (int i = 0; i < NumProfileZones; ++i)
+        m_csvFile << "," << sample.cpuTime[i];
+
+    for (int i = 0; i < NumProfileZones; ++i)
+    {
+        if (ZoneHasGpuTimer((ProfileZone)i))
+            m_csvFile << "," << sample.gpuTime[i];
+    }
+
+    m_csvFile << "\n";
+}
\ No newline at end of file
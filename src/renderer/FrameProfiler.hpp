@@ -0,0 +1,143 @@
+#ifndef FRAMEPROFILER_HPP
+#define FRAMEPROFILER_HPP
+
+#include "renderer/OpenGL.hpp"
+#include "Timer.hpp"
+#include <fstream>
+#include <string>
+
+/*
+ * Per-frame CPU timers and GPU timer queries (GL_TIME_ELAPSED) for the main loop phases.
+ * GPU queries are double-buffered: results of the previous frame are collected at the end
+ * of the current one, so reading them never stalls the pipeline.
+ */
+
+enum ProfileZone
+{
+    ProfileUpdate,      // Application::OnUpdate (camera + visible set)
+    ProfileVisibleSet,  // BspMap::CalculateVisibleFaces
+    ProfileRender,      // map rendering (all eyes/mirror passes combined)
+    ProfileStatsUI,     // stats overlay
+    ProfileSwap,        // SDL_GL_SwapWindow
+    NumProfileZones
+};
+
+
+// min/avg/p99 over the rolling history (milliseconds)
+struct ProfileSummary
+{
+    float minTime;
+    float avgTime;
+    float p99Time;
+};
+
+
+class FrameProfiler
+{
+public:
+    static const int s_historySize = 256;   // frames kept for graphs and summaries
+
+    static FrameProfiler* GetInstance();
+
+    void Init();      // create timer queries (requires GL context)
+    void Destroy();
+
+    void BeginCpu(ProfileZone zone) { m_cpuTimers[zone].Reset(); }
+    void EndCpu(ProfileZone zone)   { m_cpuAccum[zone] += (float)m_cpuTimers[zone].ElapsedMs(); }
+    void BeginGpu(ProfileZone zone);
+    void EndGpu(ProfileZone zone);
+
+    void EndFrame();  // call right after buffer swap
+
+    // write every frame to a CSV file until stopped
+    bool StartCsvCapture(const std::string &filename);
+    void StopCsvCapture();
+    bool CsvCaptureActive() const { return m_csvFile.is_open(); }
+
+    // history access - age 0 is the last completed frame (GPU times lag one frame behind, negative if not available)
+    int   NumFrames() const { return m_numFrames < s_historySize ? m_numFrames : s_historySize; }
+    float FrameTime(int age) const         { return History(age).frameTime; }
+    float CpuTime(ProfileZone zone, int age) const { return History(age).cpuTime[zone]; }
+    float GpuTime(ProfileZone zone, int age) const { return History(age).gpuTime[zone]; }
+    float GpuFrameTime(int age) const;     // all GPU zones combined
+
+    ProfileSummary FrameSummary() const;
+    ProfileSummary CpuSummary(ProfileZone zone) const;
+    ProfileSummary GpuSummary(ProfileZone zone) const;
+
+    static const char *ZoneName(ProfileZone zone);
+    static bool ZoneHasGpuTimer(ProfileZone zone) { return zone == ProfileRender || zone == ProfileStatsUI; }
+
+private:
+    static const int s_maxQueries = 8;      // GPU queries per zone per frame (eyes + mirror passes)
+
+    struct FrameSample
+    {
+        float frameTime;
+        float cpuTime[NumProfileZones];
+        float gpuTime[NumProfileZones];
+    };
+
+    FrameProfiler() : m_initialized(false), m_queryBuffer(0), m_numFrames(0)
+    {
+        for (int i = 0; i < NumProfileZones; ++i)
+        {
+            m_cpuAccum[i]      = 0.f;
+            m_queryActive[i]   = false;
+            m_numQueries[0][i] = 0;
+            m_numQueries[1][i] = 0;
+        }
+    }
+
+    ~FrameProfiler()
+    {
+        StopCsvCapture();
+    }
+
+    const FrameSample &History(int age) const { return m_history[(m_numFrames - 1 - age + s_historySize) % s_historySize]; }
+    ProfileSummary Summarize(float *values, int count) const;
+    void WriteCsvLine(int frame, const FrameSample &sample);
+
+    bool  m_initialized;
+    Timer m_frameTimer;
+    Timer m_cpuTimers[NumProfileZones];
+    float m_cpuAccum[NumProfileZones];        // current frame CPU time per zone (accumulated over passes)
+
+    GLuint m_queries[2][NumProfileZones][s_maxQueries];
+    int    m_numQueries[2][NumProfileZones];  // queries issued per zone in each buffer
+    bool   m_queryActive[NumProfileZones];
+    int    m_queryBuffer;                     // query buffer used by the current frame
+
+    FrameSample m_history[s_historySize];
+    int         m_numFrames;                  // frames completed since start
+
+    std::ofstream m_csvFile;
+};
+
+
+// CPU (and optionally GPU) timer for the current scope
+class ProfileScope
+{
+public:
+    ProfileScope(ProfileZone zone, bool gpu = false) : m_zone(zone), m_gpu(gpu)
+    {
+        FrameProfiler::GetInstance()->BeginCpu(m_zone);
+
+        if (m_gpu)
+            FrameProfiler::GetInstance()->BeginGpu(m_zone);
+    }
+
+    ~ProfileScope()
+    {
+        if (m_gpu)
+            FrameProfiler::GetInstance()->EndGpu(m_zone);
+
+        FrameProfiler::GetInstance()->EndCpu(m_zone);
+    }
+
+private:
+    ProfileZone m_zone;
+    bool        m_gpu;
+};
+
+#endif
\ No newline at end of file
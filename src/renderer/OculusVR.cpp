@@ -1,5 +1,6 @@
 #include "renderer/OculusVR.hpp"
 #include "renderer/ShaderManager.hpp"
+#include <algorithm>
 //#include <GL/CAPI_GLE.h>
 
 OculusVR::OVRBuffer::OVRBuffer(const ovrSession &session, int eyeIdx)
@@ -369,6 +370,32 @@ const OVR::Matrix4f OculusVR::GetEyeMVPMatrix(int eyeIndex) const
     return m_projectionMatrix[eyeIndex] * m_eyeOrientation[eyeIndex] * m_eyePose[eyeIndex];
 }
 
+// conservative union of both eye frusta, so a single visible set is correct for both eyes
+const OVR::Matrix4f OculusVR::GetStereoCullingMatrix() const
+{
+    const ovrFovPort &leftFov  = m_eyeRenderDesc[ovrEye_Left].Fov;
+    const ovrFovPort &rightFov = m_eyeRenderDesc[ovrEye_Right].Fov;
+
+    ovrFovPort fov;
+    fov.UpTan    = std::max(leftFov.UpTan,    rightFov.UpTan);
+    fov.DownTan  = std::max(leftFov.DownTan,  rightFov.DownTan);
+    fov.LeftTan  = std::max(leftFov.LeftTan,  rightFov.LeftTan);
+    fov.RightTan = std::max(leftFov.RightTan, rightFov.RightTan);
+
+    OVR::Vector3f leftEyePos(m_eyeRenderPose[ovrEye_Left].Position);
+    OVR::Vector3f rightEyePos(m_eyeRenderPose[ovrEye_Right].Position);
+    OVR::Vector3f centerPos = (leftEyePos + rightEyePos) * 0.5f;
+    float halfIPD = (rightEyePos - leftEyePos).Length() * 0.5f;
+
+    // move the apex behind the eyes until the side planes enclose both eye frusta
+    float apexOffset = std::max(halfIPD / fov.LeftTan, halfIPD / fov.RightTan);
+
+    OVR::Matrix4f projection  = OVR::Matrix4f(ovrMatrix4f_Projection(fov, 0.01f + apexOffset, 10000.0f + apexOffset, ovrProjection_None));
+    OVR::Matrix4f orientation = OVR::Matrix4f(OVR::Quatf(m_eyeRenderPose[ovrEye_Left].Orientation).Inverted());
+
+    return projection * OVR::Matrix4f::Translation(0.f, 0.f, -apexOffset) * orientation * OVR::Matrix4f::Translation(-centerPos);
+}
+
 void OculusVR::SubmitFrame()
 {
     // set up positional data
@@ -35,6 +35,7 @@ public:
     const OVR::Matrix4f OnEyeRender(int eyeIndex);
     void  OnEyeRenderFinish(int eyeIndex);
     const OVR::Matrix4f GetEyeMVPMatrix(int eyeIdx) const;
+    const OVR::Matrix4f GetStereoCullingMatrix() const;   // frustum enclosing both eyes (valid after OnRenderStart)
     void  SubmitFrame();
 
     void  BlitMirror(ovrEyeType numEyes=ovrEye_Count, int offset = 0);   // regular OculusVR mirror view
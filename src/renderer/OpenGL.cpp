@@ -1,4 +1,4 @@
-#include "renderer/OpenGL.hpp"
+#include "renderer/Projection.hpp"
 
 namespace Renderer
 {
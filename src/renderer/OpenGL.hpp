@@ -10,12 +10,6 @@
 
 #include "Math.hpp"
 #include "Utils.hpp"
-
-namespace Renderer
-{
-    void MakePerspective(Math::Matrix4f &matrix, float fov, float scrRatio, float nearPlane, float farPlane);
-    void MakeOrthogonal(Math::Matrix4f &matrix, float left, float right, float bottom, float top, float nearPlane, float farPlane);
-    void MakeView(Math::Matrix4f &matrix, const Math::Vector3f &eye, const Math::Vector3f &target, const Math::Vector3f &up);
-}
+#include "renderer/Projection.hpp"
 
 #endif
\ No newline at end of file
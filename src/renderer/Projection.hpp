@@ -0,0 +1,17 @@
+#ifndef PROJECTION_INCLUDED
+#define PROJECTION_INCLUDED
+
+#include "Math.hpp"
+
+/*
+ * View/projection matrix helpers (no GL dependency)
+ */
+
+namespace Renderer
+{
+    void MakePerspective(Math::Matrix4f &matrix, float fov, float scrRatio, float nearPlane, float farPlane);
+    void MakeOrthogonal(Math::Matrix4f &matrix, float left, float right, float bottom, float top, float nearPlane, float farPlane);
+    void MakeView(Math::Matrix4f &matrix, const Math::Vector3f &eye, const Math::Vector3f &target, const Math::Vector3f &up);
+}
+
+#endif
\ No newline at end of file
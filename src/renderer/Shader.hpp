@@ -13,6 +13,8 @@ enum UniformId
     UseLightmaps,
     UseAlphaTest,
     WorldScaleFactor,
+    CameraPosition,
+    TessLodError,
     NUM_UNIFORMS
 };
 
@@ -21,10 +23,12 @@ struct ShaderProgram
     GLuint id;
     GLuint vertShader;
     GLuint fragShader;
+    GLuint tessControlShader;
+    GLuint tessEvalShader;
 
     GLint uniforms[NUM_UNIFORMS];
 
-    ShaderProgram() : id(0), vertShader(0), fragShader(0)
+    ShaderProgram() : id(0), vertShader(0), fragShader(0), tessControlShader(0), tessEvalShader(0)
     {
         for (int i = 0; i < NUM_UNIFORMS; i++)
         {
@@ -8,7 +8,9 @@ static const char* uniformNames[] = { "ModelViewProjectionMatrix",
                                       "renderLightmaps",
                                       "useLightmaps",
                                       "useAlphaTest",
-                                      "worldScaleFactor" };
+                                      "worldScaleFactor",
+                                      "cameraPosition",
+                                      "tessLodError" };
 
 ShaderManager* ShaderManager::GetInstance()
 {
@@ -40,6 +42,16 @@ void ShaderManager::DestroyShaders()
         {
             glDeleteShader(m_shaderProgram[i].fragShader);
         }
+
+        if (glIsShader(m_shaderProgram[i].tessControlShader))
+        {
+            glDeleteShader(m_shaderProgram[i].tessControlShader);
+        }
+
+        if (glIsShader(m_shaderProgram[i].tessEvalShader))
+        {
+            glDeleteShader(m_shaderProgram[i].tessEvalShader);
+        }
     }
 }
 
@@ -50,6 +62,10 @@ void ShaderManager::LoadShaders()
     LoadShader(BasicShader, "res/Basic.vsh", "res/Basic.fsh");
     LoadShader(FontShader,  "res/Font.vsh",  "res/Font.fsh");
     LoadShader(OVRFrustumShader, "res/OVRFrustum.vsh", "res/OVRFrustum.fsh");
+
+    // optional - curved surfaces fall back to CPU tesselation without it
+    if (GLEW_ARB_tessellation_shader)
+        LoadShader(BasicTessShader, "res/BasicTess.vsh", "res/BasicTess.tcs", "res/BasicTess.tes", "res/Basic.fsh");
 }
 
 // use shader program
@@ -124,13 +140,21 @@ void ShaderManager::CompileShader(GLuint *newShader, GLenum shaderType, const ch
 // create the actual shader program
 bool ShaderManager::LinkShader(GLuint* const pProgramObject,
                                const GLuint VertexShader,
-                               const GLuint FragmentShader)
+                               const GLuint FragmentShader,
+                               const GLuint TessControlShader,
+                               const GLuint TessEvalShader)
 {
     *pProgramObject = glCreateProgram();
 
     glAttachShader(*pProgramObject, FragmentShader);
     glAttachShader(*pProgramObject, VertexShader);
 
+    if (TessControlShader && TessEvalShader)
+    {
+        glAttachShader(*pProgramObject, TessControlShader);
+        glAttachShader(*pProgramObject, TessEvalShader);
+    }
+
     // Link the program object
     GLint Linked;
     glLinkProgram(*pProgramObject);
@@ -164,6 +188,38 @@ void ShaderManager::LoadShader(ShaderName shaderName, const char* vshFilename, c
 
     LinkShader(&m_shaderProgram[shaderName].id, m_shaderProgram[shaderName].vertShader, m_shaderProgram[shaderName].fragShader);
 
+    GetUniformLocations(shaderName);
+}
+
+
+void ShaderManager::LoadShader(ShaderName shaderName, const char* vshFilename, const char *tcsFilename, const char *tesFilename, const char *fshFilename)
+{
+    std::string vShaderSrc   = ReadShaderFromFile(vshFilename);
+    std::string tcShaderSrc  = ReadShaderFromFile(tcsFilename);
+    std::string teShaderSrc  = ReadShaderFromFile(tesFilename);
+    std::string fShaderSrc   = ReadShaderFromFile(fshFilename);
+
+    ShaderProgram &program = m_shaderProgram[shaderName];
+
+    CompileShader(&program.vertShader, GL_VERTEX_SHADER, vShaderSrc.c_str());
+    CompileShader(&program.tessControlShader, GL_TESS_CONTROL_SHADER, tcShaderSrc.c_str());
+    CompileShader(&program.tessEvalShader, GL_TESS_EVALUATION_SHADER, teShaderSrc.c_str());
+    CompileShader(&program.fragShader, GL_FRAGMENT_SHADER, fShaderSrc.c_str());
+
+    // a broken tesselation program is reported as unsupported (id 0)
+    if (!LinkShader(&program.id, program.vertShader, program.fragShader, program.tessControlShader, program.tessEvalShader))
+    {
+        glDeleteProgram(program.id);
+        program.id = 0;
+        return;
+    }
+
+    GetUniformLocations(shaderName);
+}
+
+
+void ShaderManager::GetUniformLocations(ShaderName shaderName)
+{
     // assign texture locations to samplers
     glUniform1i(glGetUniformLocation(m_shaderProgram[shaderName].id, "sTexture"),  0);  // Texture unit 0 is for base images.
     glUniform1i(glGetUniformLocation(m_shaderProgram[shaderName].id, "sLightmap"), 1);  // Texture unit 1 is for lightmaps.
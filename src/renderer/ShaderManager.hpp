@@ -14,6 +14,7 @@ public:
         BasicShader,
         FontShader,
         OVRFrustumShader,
+        BasicTessShader,    // Basic with curved surfaces evaluated in tesselation shaders (id is 0 if not supported)
         NUM_SHADERS
     };
 
@@ -36,7 +37,10 @@ private:
     std::string ReadShaderFromFile(const char *filename);
     void CompileShader(GLuint *newShader, GLenum shaderType, const char *shaderSrc);
     void LoadShader(ShaderName shaderName, const char* vshFilename, const char *fshFilename);
-    bool LinkShader(GLuint* const pProgramObject, const GLuint VertexShader, const GLuint FragmentShader);
+    void LoadShader(ShaderName shaderName, const char* vshFilename, const char *tcsFilename, const char *tesFilename, const char *fshFilename);
+    bool LinkShader(GLuint* const pProgramObject, const GLuint VertexShader, const GLuint FragmentShader,
+                    const GLuint TessControlShader = 0, const GLuint TessEvalShader = 0);
+    void GetUniformLocations(ShaderName shaderName);
     ShaderName m_activeShader;
 
     ShaderProgram m_shaderProgram[NUM_SHADERS];
@@ -1,4 +1,5 @@
 #include "renderer/Texture.hpp"
+#include "renderer/UploadRing.hpp"
 #include "stb_image/stb_image.h"
 
 
@@ -13,7 +14,8 @@ Texture::~Texture()
     if(m_textureData != NULL)
         stbi_image_free( m_textureData );
 
-    if (glIsTexture(m_texId))
+    // texture may have been decoded on a worker thread and never uploaded - skip GL calls then
+    if (m_texId != 0 && glIsTexture(m_texId))
     {
         glDeleteTextures(1, &m_texId);
     }
@@ -33,7 +35,14 @@ GLuint Texture::Load()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, m_components, m_width, m_height, 0, m_components == 3 ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, m_textureData);
+    GLenum format = m_components == 3 ? GL_RGB : GL_RGBA;
+
+    // allocate storage, then transfer pixels through the upload ring
+    glTexImage2D(GL_TEXTURE_2D, 0, m_components, m_width, m_height, 0, format, GL_UNSIGNED_BYTE, NULL);
+
+    const GLvoid *pixels = UploadRing::GetInstance()->Stage(m_textureData, m_width * m_height * m_components);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, format, GL_UNSIGNED_BYTE, pixels);
+    UploadRing::GetInstance()->Commit();
 
     stbi_image_free( m_textureData );
 
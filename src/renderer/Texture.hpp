@@ -16,6 +16,7 @@ public:
     const int Height()     const { return m_height; }
     const int Components() const { return m_components; }
     const GLuint Id()      const { return m_texId; }
+    const unsigned char *Data() const { return m_textureData; } // decoded pixels (NULL once uploaded)
     
 private:
     Texture(const char *filename);
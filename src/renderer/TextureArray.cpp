@@ -0,0 +1,160 @@
+#include "renderer/TextureArray.hpp"
+#include "renderer/CompressedTexture.hpp"
+#include "renderer/Texture.hpp"
+#include "renderer/UploadRing.hpp"
+#include <algorithm>
+
+TextureArray::TextureArray(int width, int height, int numLayers, GLenum compressedFormat) : m_format(compressedFormat ? compressedFormat : GL_RGBA8),
+                                                                                           m_numLevels(CompressedTexture::NumMipLevels(width, height)),
+                                                                                           m_width(width), m_height(height), m_numLayers(numLayers), m_usedLayers(0), m_texId(0)
+{
+    glGenTextures(1, &m_texId);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_texId);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+    // allocate all mip levels up front so single layers can be uploaded level by level
+    int levelWidth  = m_width;
+    int levelHeight = m_height;
+
+    for (int level = 0; level < m_numLevels; ++level)
+    {
+        if (Compressed())
+        {
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, m_format, levelWidth, levelHeight, m_numLayers, 0,
+                                   CompressedTexture::LevelSize(m_format, levelWidth, levelHeight) * m_numLayers, NULL);
+        }
+        else
+        {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, levelWidth, levelHeight, m_numLayers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        }
+
+        levelWidth  = std::max(1, levelWidth  / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, m_numLevels - 1);
+}
+
+
+TextureArray::~TextureArray()
+{
+    if (m_texId != 0 && glIsTexture(m_texId))
+    {
+        glDeleteTextures(1, &m_texId);
+    }
+}
+
+
+int TextureArray::AddLayer(const Texture &texture)
+{
+    if (Compressed() || texture.Data() == NULL || texture.Width() != m_width || texture.Height() != m_height)
+        return -1;
+
+    return AddLayer(texture.Data(), texture.Components());
+}
+
+
+int TextureArray::AddLayer(const unsigned char *pixels, int components)
+{
+    static const GLenum formats[] = { GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA };
+
+    if (Full())
+        return -1;
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_texId);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    const GLvoid *stagedPixels = UploadRing::GetInstance()->Stage(pixels, m_width * m_height * components);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, m_usedLayers, m_width, m_height, 1, formats[components - 1], GL_UNSIGNED_BYTE, stagedPixels);
+    UploadRing::GetInstance()->Commit();
+
+    return m_usedLayers++;
+}
+
+
+int TextureArray::AddLayer(const CompressedTexture::MipChain &levels)
+{
+    if (Full() || Compressed() || (int)levels.size() != m_numLevels || levels[0].size() != (size_t)(m_width * m_height * 4))
+        return -1;
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_texId);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    int levelWidth  = m_width;
+    int levelHeight = m_height;
+
+    // only this layer is touched - other layers keep their mip levels
+    for (int level = 0; level < m_numLevels; ++level)
+    {
+        const std::vector<unsigned char> &levelData = levels[level];
+
+        const GLvoid *stagedPixels = UploadRing::GetInstance()->Stage(levelData.data(), levelData.size());
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, m_usedLayers, levelWidth, levelHeight, 1, GL_RGBA, GL_UNSIGNED_BYTE, stagedPixels);
+        UploadRing::GetInstance()->Commit();
+
+        levelWidth  = std::max(1, levelWidth  / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+
+    return m_usedLayers++;
+}
+
+
+int TextureArray::AddLayer(const CompressedTexture &texture)
+{
+    if (Full() || texture.Format() != m_format || texture.Width() != m_width || texture.Height() != m_height)
+        return -1;
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_texId);
+
+    int levelWidth  = m_width;
+    int levelHeight = m_height;
+
+    for (int level = 0; level < m_numLevels; ++level)
+    {
+        const std::vector<unsigned char> &levelData = texture.Level(level);
+
+        const GLvoid *stagedData = UploadRing::GetInstance()->Stage(levelData.data(), levelData.size());
+        glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, m_usedLayers, levelWidth, levelHeight, 1, m_format, levelData.size(), stagedData);
+        UploadRing::GetInstance()->Commit();
+
+        levelWidth  = std::max(1, levelWidth  / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+
+    return m_usedLayers++;
+}
+
+
+void TextureArray::GenerateMipmaps()
+{
+    if (Compressed())
+        return;
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_texId);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+}
+
+
+size_t TextureArray::LayerSize() const
+{
+    size_t size = 0;
+    int levelWidth  = m_width;
+    int levelHeight = m_height;
+
+    for (int level = 0; level < m_numLevels; ++level)
+    {
+        if (Compressed())
+            size += CompressedTexture::LevelSize(m_format, levelWidth, levelHeight);
+        else
+            size += levelWidth * levelHeight * 4;
+
+        levelWidth  = std::max(1, levelWidth  / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+
+    return size;
+}
\ No newline at end of file
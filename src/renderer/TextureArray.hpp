@@ -0,0 +1,55 @@
+#ifndef TEXTUREARRAY_INCLUDED
+#define TEXTUREARRAY_INCLUDED
+
+#include "renderer/OpenGL.hpp"
+#include "renderer/CompressedTexture.hpp"
+
+class Texture;
+
+/*
+ *  Same-size textures stored as layers of a GL_TEXTURE_2D_ARRAY (with full mip chain).
+ *  Either RGBA8 with mipmaps built on the CPU (or generated on the GPU) or block compressed with precomputed mip levels.
+ */
+
+class TextureArray
+{
+public:
+    // compressedFormat: 0 for RGBA8 or the format of the CompressedTextures to be stored
+    TextureArray(int width, int height, int numLayers, GLenum compressedFormat = 0);
+    ~TextureArray();
+
+    // copy pixels of a decoded (not yet uploaded) texture or raw width x height pixels into the next free layer,
+    // returns the layer index or -1 if the array is full or the size doesn't match
+    int  AddLayer(const Texture &texture);
+    int  AddLayer(const unsigned char *pixels, int components);
+    // upload a full RGBA8 mip chain (see CompressedTexture::BuildMipChain) - no GenerateMipmaps() needed afterwards
+    int  AddLayer(const CompressedTexture::MipChain &levels);
+    // upload all mip levels of a compressed texture, format and size have to match
+    int  AddLayer(const CompressedTexture &texture);
+    // regenerates the mip levels of all layers - call once after adding layers with base level pixels only (no-op for compressed arrays)
+    void GenerateMipmaps();
+
+    bool Full() const { return m_usedLayers == m_numLayers; }
+
+    const int Width()      const { return m_width; }
+    const int Height()     const { return m_height; }
+    const int NumLayers()  const { return m_numLayers; }
+    const int UsedLayers() const { return m_usedLayers; }
+    const GLuint Id()      const { return m_texId; }
+    const GLenum Format()  const { return m_format; }
+    bool Compressed()      const { return m_format != GL_RGBA8; }
+
+    size_t LayerSize()  const;  // video memory used by one layer including its mip levels (bytes)
+    size_t MemorySize() const { return LayerSize() * m_numLayers; }  // all layers, used or not (bytes)
+
+private:
+    GLenum m_format;
+    int    m_numLevels;
+    int    m_width;
+    int    m_height;
+    int    m_numLayers;
+    int    m_usedLayers;
+    GLuint m_texId;
+};
+
+#endif
\ No newline at end of file
@@ -1,4 +1,11 @@
 #include "renderer/TextureManager.hpp"
+#include "renderer/CompressedTexture.hpp"
+#include "stb_image/stb_image.h"
+#include "MappedFile.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 
 
 TextureManager* TextureManager::GetInstance()
@@ -16,40 +23,265 @@ TextureManager::~TextureManager()
 
 void TextureManager::ReleaseTextures()
 {
-    for (std::map<std::string, Texture*>::iterator it = m_textures.begin(); it != m_textures.end(); ++it)
+    // handles stay valid, textures just become unloaded
+    for (auto &entry : m_entries)
     {
-        delete it->second;
+        if (entry.texture != NULL)
+        {
+            delete entry.texture;
+            entry.texture = NULL;
+            entry.state   = TextureUnloaded;
+        }
     }
 
     m_currentTexture = 0;
 }
 
-Texture *TextureManager::LoadTexture(const char *textureName)
+TextureHandle TextureManager::RegisterTexture(const char *textureName)
+{
+    unsigned long long hash = HashBytes((const unsigned char *)textureName, strlen(textureName));
+
+    std::lock_guard<std::mutex> lock(m_registryMutex);
+    TextureHandle handle = Lookup(textureName, hash);
+
+    if (handle != InvalidTextureHandle)
+        return handle;
+
+    // keep the table at most half full so probe sequences stay short
+    if ((m_entries.size() + 1) * 2 > m_hashTable.size())
+        Rehash(std::max(m_hashTable.size() * 2, (size_t)256));
+
+    handle = (TextureHandle)m_entries.size();
+
+    TextureEntry entry = { textureName, hash, TextureUnloaded, NULL };
+    m_entries.push_back(entry);
+
+    size_t mask = m_hashTable.size() - 1;
+    size_t slot = hash & mask;
+
+    while (m_hashTable[slot] != InvalidTextureHandle)
+        slot = (slot + 1) & mask;
+
+    m_hashTable[slot] = handle;
+
+    return handle;
+}
+
+TextureHandle TextureManager::FindTexture(const char *textureName) const
 {
-    if (m_textures.count(textureName) == 0)
+    unsigned long long hash = HashBytes((const unsigned char *)textureName, strlen(textureName));
+
+    std::lock_guard<std::mutex> lock(m_registryMutex);
+
+    return Lookup(textureName, hash);
+}
+
+const char *TextureManager::TextureName(TextureHandle handle) const
+{
+    std::lock_guard<std::mutex> lock(m_registryMutex);
+
+    return m_entries[handle].name.c_str();
+}
+
+// registry mutex has to be held by the caller
+TextureHandle TextureManager::Lookup(const char *textureName, unsigned long long hash) const
+{
+    if (m_hashTable.empty())
+        return InvalidTextureHandle;
+
+    size_t mask = m_hashTable.size() - 1;
+
+    for (size_t slot = hash & mask; m_hashTable[slot] != InvalidTextureHandle; slot = (slot + 1) & mask)
+    {
+        const TextureEntry &entry = m_entries[m_hashTable[slot]];
+
+        // full hash compare first - names are only compared on a (likely) hit
+        if (entry.hash == hash && entry.name == textureName)
+            return m_hashTable[slot];
+    }
+
+    return InvalidTextureHandle;
+}
+
+void TextureManager::Rehash(size_t tableSize)
+{
+    m_hashTable.assign(tableSize, InvalidTextureHandle);
+
+    size_t mask = tableSize - 1;
+
+    for (size_t i = 0; i < m_entries.size(); ++i)
+    {
+        size_t slot = m_entries[i].hash & mask;
+
+        while (m_hashTable[slot] != InvalidTextureHandle)
+            slot = (slot + 1) & mask;
+
+        m_hashTable[slot] = (TextureHandle)i;
+    }
+}
+
+// names with an extension are tried as they are first, then every name gets each of the supported extensions
+// (bsp texture names have none, but may contain dots)
+bool TextureManager::CandidateFilename(TextureHandle handle, int candidate, char *filename) const
+{
+    static const char *imageExtensions[] = { ".jpg", ".tga" };
+    static const int   numExtensions     = sizeof(imageExtensions) / sizeof(imageExtensions[0]);
+
+    const char *name      = TextureName(handle);
+    const char *lastSlash = strrchr(name, '/');
+    const char *extension = strrchr(name, '.');
+    int asIs = (extension != NULL && (lastSlash == NULL || extension > lastSlash)) ? 1 : 0;
+
+    if (candidate < asIs)
+        return snprintf(filename, s_maxFilename, "%s", name) < (int)s_maxFilename;
+
+    if (candidate - asIs >= numExtensions)
+        return false;
+
+    return snprintf(filename, s_maxFilename, "%s%s", name, imageExtensions[candidate - asIs]) < (int)s_maxFilename;
+}
+
+TextureHandle TextureManager::LoadTexture(const char *textureName)
+{
+    TextureHandle handle = RegisterTexture(textureName);
+    TextureEntry &entry  = m_entries[handle];
+
+    if (entry.state == TextureMissing)
+        return InvalidTextureHandle;
+
+    if (entry.texture == NULL)
     {
         LOG_MESSAGE("[TextureManager] Loading texture: " << textureName);
-        Texture *newTex = new Texture(textureName);   
+        Texture *decodedTex = DecodeTexture(handle);
 
         // failed to load texture/file doesn't exist
-        if (newTex->Load() == 0)
+        if (decodedTex == NULL || UploadTexture(handle, decodedTex) == NULL)
         {
-            delete newTex;
-            return NULL;
+            entry.state = TextureMissing;
+            return InvalidTextureHandle;
         }
+    }
 
-        m_textures[textureName] = newTex;       
+    return handle;
+}
+
+// decode image file without touching OpenGL (thread safe) - returns NULL if file could not be read
+Texture *TextureManager::DecodeTexture(const char *textureName) const
+{
+    Texture *newTex = new Texture(textureName);
+
+    if (newTex->m_textureData == NULL)
+    {
+        delete newTex;
+        return NULL;
+    }
+
+    return newTex;
+}
+
+// decode the first readable image file of a registered name (thread safe)
+Texture *TextureManager::DecodeTexture(TextureHandle handle) const
+{
+    char filename[s_maxFilename];
+
+    for (int i = 0; CandidateFilename(handle, i, filename); ++i)
+    {
+        Texture *newTex = DecodeTexture(filename);
+
+        if (newTex != NULL)
+            return newTex;
     }
 
-    return m_textures[textureName];
+    return NULL;
 }
 
-void TextureManager::BindTexture(Texture *t)
+// upload a decoded texture as the standalone texture of a handle (takes ownership of decodedTex)
+Texture *TextureManager::UploadTexture(TextureHandle handle, Texture *decodedTex)
 {
-    if (m_currentTexture != t->Id())
+    TextureEntry &entry = m_entries[handle];
+
+    if (entry.texture != NULL)
+    {
+        delete decodedTex;
+        return entry.texture;
+    }
+
+    LOG_MESSAGE("[TextureManager] Uploading texture: " << entry.name);
+
+    if (decodedTex->Load() == 0)
+    {
+        delete decodedTex;
+        return NULL;
+    }
+
+    entry.texture = decodedTex;
+    entry.state   = TextureResident;
+
+    return decodedTex;
+}
+
+void TextureManager::FreeDecodedTexture(Texture *decodedTex) const
+{
+    delete decodedTex;
+}
+
+CompressedTexture *TextureManager::DecodeCompressedTexture(TextureHandle handle) const
+{
+    char filename[s_maxFilename];
+
+    for (int i = 0; CandidateFilename(handle, i, filename); ++i)
+    {
+        CompressedTexture *compressedTex = DecodeCompressedTexture(filename);
+
+        if (compressedTex != NULL)
+            return compressedTex;
+    }
+
+    return NULL;
+}
+
+// compressed textures are cached in "<textureName>.btc", tagged with the hash of the source file
+CompressedTexture *TextureManager::DecodeCompressedTexture(const char *textureName) const
+{
+    MappedFile sourceFile;
+
+    if (!sourceFile.Open(textureName))
+        return NULL;
+
+    std::string cacheName  = std::string(textureName) + ".btc";
+    unsigned long long sourceHash = HashBytes(sourceFile.Data(), sourceFile.Size());
+
+    CompressedTexture *compressedTex = CompressedTexture::LoadCache(cacheName, sourceHash);
+
+    if (compressedTex)
+        return compressedTex;
+
+    int width, height, components;
+    unsigned char *pixels = stbi_load_from_memory(sourceFile.Data(), (int)sourceFile.Size(), &width, &height, &components, 0);
+
+    if (pixels == NULL)
+        return NULL;
+
+    compressedTex = CompressedTexture::Compress(pixels, width, height, components);
+    stbi_image_free(pixels);
+
+    // read-only data directories are fine, the texture is just compressed again next time
+    if (compressedTex && !compressedTex->WriteCache(cacheName, sourceHash))
+    {
+        LOG_MESSAGE("[TextureManager] Could not write compressed texture cache: " << cacheName);
+    }
+
+    return compressedTex;
+}
+
+void TextureManager::BindTexture(TextureHandle handle)
+{
+    GLuint texId = m_entries[handle].texture ? m_entries[handle].texture->Id() : 0;
+
+    if (m_currentTexture != texId)
     {
-        m_currentTexture = t->Id();
-        glBindTexture(GL_TEXTURE_2D, t->Id());
+        m_currentTexture = texId;
+        glBindTexture(GL_TEXTURE_2D, texId);
     }
 }
 
@@ -3,26 +3,97 @@
 
 #include "renderer/OpenGL.hpp"
 #include "renderer/Texture.hpp"
-#include <map>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class CompressedTexture;
+
+// stable index of a registered texture name (valid for the lifetime of the TextureManager)
+typedef unsigned int TextureHandle;
+
+static const TextureHandle InvalidTextureHandle = 0xFFFFFFFF;
+
+// residency of a registered texture
+enum TextureState
+{
+    TextureUnloaded,
+    TextureLoading,   // queued for decoding/upload
+    TextureResident,  // uploaded (as standalone texture or by the owner of the handle, e.g. into a texture array)
+    TextureMissing    // no readable image file
+};
+
+/*
+ *  Texture registry: names are interned once and looked up through an open addressing hash table,
+ *  everything else refers to textures by handle. Names without extension (bsp texture names)
+ *  are resolved to .jpg or .tga files when decoding.
+ */
 
 class TextureManager
 {
 public:
     static TextureManager* GetInstance();
 
-    Texture *LoadTexture(const char *textureName);
-    void BindTexture(Texture *t);
+    // handle of a texture name, registered as unloaded if it's new (context thread only)
+    TextureHandle RegisterTexture(const char *textureName);
+    // InvalidTextureHandle if the name was never registered (thread safe)
+    TextureHandle FindTexture(const char *textureName) const;
+    const char   *TextureName(TextureHandle handle) const;  // thread safe
+
+    // residency tracking and standalone textures (context thread only)
+    TextureState GetState(TextureHandle handle) const           { return m_entries[handle].state; }
+    void         SetState(TextureHandle handle, TextureState s) { m_entries[handle].state = s; }
+    Texture     *GetTexture(TextureHandle handle) const         { return m_entries[handle].texture; }
+
+    // register, decode and upload - returns InvalidTextureHandle if the file could not be loaded
+    TextureHandle LoadTexture(const char *textureName);
+
+    // two-step loading: image decoding is GL-free and may run on worker threads,
+    // upload has to happen on the GL context thread
+    Texture *DecodeTexture(const char *textureName) const;
+    Texture *DecodeTexture(TextureHandle handle) const;  // first readable file of a registered name
+    Texture *UploadTexture(TextureHandle handle, Texture *decodedTex);
+    // release a decoded texture that won't be uploaded (e.g. after copying it into a TextureArray)
+    void FreeDecodedTexture(Texture *decodedTex) const;
+    // decode and block compress an image file (thread safe), reusing the transcoding cache next to it if still valid -
+    // returns NULL if the file could not be read
+    CompressedTexture *DecodeCompressedTexture(const char *textureName) const;
+    CompressedTexture *DecodeCompressedTexture(TextureHandle handle) const;
+    void SetCompression(bool enabled) { m_compression = enabled; }
+    bool CompressionEnabled() const   { return m_compression; }
+
+    void BindTexture(TextureHandle handle);
     void UnBindTexture(); // set current texture to 0;
     void ReleaseTextures();
 private:
-    TextureManager() : m_currentTexture(0)
+    static const size_t s_maxFilename = 256;   // longer names can't be resolved to a file
+
+    struct TextureEntry
+    {
+        std::string        name;
+        unsigned long long hash;
+        TextureState       state;
+        Texture           *texture;  // standalone texture (NULL if not loaded or owned elsewhere)
+    };
+
+    TextureManager() : m_currentTexture(0), m_compression(false)
     {
     }
 
     ~TextureManager();
 
-    std::map<std::string, Texture *> m_textures;
+    TextureHandle Lookup(const char *textureName, unsigned long long hash) const;
+    void          Rehash(size_t tableSize);
+    // n-th image file to try for a registered name, false if there are no more candidates
+    bool CandidateFilename(TextureHandle handle, int candidate, char *filename) const;
+
+    std::deque<TextureEntry>   m_entries;     // indexed by handle - never shrinks, so names stay put
+    std::vector<TextureHandle> m_hashTable;   // linear probing, power of 2 size, InvalidTextureHandle if empty
+    mutable std::mutex         m_registryMutex;
+
     GLuint m_currentTexture;
+    bool   m_compression;   // stream world textures block compressed (BC1/BC3)
 };
 
 #endif
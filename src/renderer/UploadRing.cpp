@@ -0,0 +1,171 @@
+#include "renderer/UploadRing.hpp"
+#include "Utils.hpp"
+#include <cstring>
+
+UploadRing* UploadRing::GetInstance()
+{
+    static UploadRing instance;
+    return &instance;
+}
+
+
+void UploadRing::Init()
+{
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+
+    if (GLEW_ARB_buffer_storage)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, s_ringSize, NULL, flags);
+        m_mappedData = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, s_ringSize, flags);
+    }
+    else
+    {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, s_ringSize, NULL, GL_STREAM_DRAW);
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    LOG_MESSAGE("[UploadRing] " << (s_ringSize >> 20) << "MB upload ring, " << (m_mappedData ? "persistently mapped" : "mapped per upload"));
+}
+
+
+void UploadRing::Destroy()
+{
+    for (auto &f : m_fences)
+        glDeleteSync(f.sync);
+
+    m_fences.clear();
+
+    if (m_buffer != 0 && glIsBuffer(m_buffer))
+    {
+        if (m_mappedData)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        glDeleteBuffers(1, &m_buffer);
+    }
+
+    m_buffer     = 0;
+    m_mappedData = NULL;
+}
+
+
+const GLvoid *UploadRing::Stage(const void *data, size_t size)
+{
+    if (m_buffer == 0 || size > s_ringSize)
+        return data;
+
+    // restart at the beginning if the upload doesn't fit at the end of the ring
+    size_t start = (m_head + s_alignment - 1) & ~(s_alignment - 1);
+
+    if (start + size > s_ringSize)
+        start = 0;
+
+    // GPU stalled or lost - let the driver copy from client memory instead
+    if (!WaitForRange(start, start + size))
+        return data;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+
+    if (m_mappedData)
+    {
+        memcpy(m_mappedData + start, data, size);
+    }
+    else
+    {
+        // range is known to be unused by the GPU - no need for the driver to synchronize
+        void *mappedRange = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, start, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+
+        if (!mappedRange)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return data;
+        }
+
+        memcpy(mappedRange, data, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    m_head        = start + size;
+    m_stagedStart = start;
+    m_staged      = true;
+
+    m_frameBytes += size;
+    m_totalBytes += size;
+
+    return (const GLvoid *)start;
+}
+
+
+void UploadRing::Commit()
+{
+    if (!m_staged)
+        return;
+
+    FencedRange range;
+    range.sync  = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    range.start = m_stagedStart;
+    range.end   = m_head;
+    m_fences.push_back(range);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    m_staged = false;
+}
+
+
+void UploadRing::EndFrame()
+{
+    m_lastFrameBytes = m_frameBytes;
+    m_frameBytes     = 0;
+
+    // release fences of transfers that already finished
+    while (!m_fences.empty())
+    {
+        GLenum result = glClientWaitSync(m_fences.front().sync, 0, 0);
+
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+            break;
+
+        glDeleteSync(m_fences.front().sync);
+        m_fences.pop_front();
+    }
+}
+
+
+// block until the GPU is done reading older uploads overlapping [start, end)
+bool UploadRing::WaitForRange(size_t start, size_t end)
+{
+    // fences signal in order - waiting for the newest overlapping upload covers all older ones
+    int lastOverlap = -1;
+
+    for (size_t i = 0; i < m_fences.size(); ++i)
+    {
+        if (m_fences[i].start < end && m_fences[i].end > start)
+            lastOverlap = (int)i;
+    }
+
+    if (lastOverlap < 0)
+        return true;
+
+    GLenum result = glClientWaitSync(m_fences[lastOverlap].sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+
+    // range is still in use - keep the fences around for the next attempt
+    if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+    {
+        LOG_MESSAGE("[UploadRing] Upload fence " << (result == GL_WAIT_FAILED ? "wait failed" : "timed out") << " - uploading from client memory");
+        return false;
+    }
+
+    for (int i = 0; i <= lastOverlap; ++i)
+        glDeleteSync(m_fences[i].sync);
+
+    m_fences.erase(m_fences.begin(), m_fences.begin() + lastOverlap + 1);
+
+    return true;
+}
\ No newline at end of file
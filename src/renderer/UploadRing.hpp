@@ -0,0 +1,69 @@
+#ifndef UPLOADRING_HPP
+#define UPLOADRING_HPP
+
+#include "renderer/OpenGL.hpp"
+#include <deque>
+
+/*
+ * Pixel unpack buffer ring for texture uploads. Pixels are copied into a persistently mapped
+ * GL_PIXEL_UNPACK_BUFFER (or a mapped range of it if ARB_buffer_storage is missing) and transferred
+ * by the driver asynchronously. Each upload is fenced, so ring space is only reused once the GPU is done with it.
+ *
+ * Usage:
+ *   const GLvoid *pixels = UploadRing::GetInstance()->Stage(data, size);
+ *   glTexSubImage2D(..., pixels);
+ *   UploadRing::GetInstance()->Commit();
+ */
+
+class UploadRing
+{
+public:
+    static const size_t s_ringSize  = 16 * 1024 * 1024;
+    static const size_t s_alignment = 256;               // start alignment of staged uploads
+
+    static UploadRing* GetInstance();
+
+    void Init();      // create the ring buffer (requires GL context)
+    void Destroy();
+
+    // copy pixels into the ring and leave it bound to GL_PIXEL_UNPACK_BUFFER - returns the offset to pass
+    // as pixel pointer to glTex(Sub)Image calls. Falls back to returning data itself (no PBO bound) if the
+    // ring is unavailable or the upload doesn't fit.
+    const GLvoid *Stage(const void *data, size_t size);
+    void Commit();    // fence the staged upload and unbind the ring
+
+    void EndFrame();  // call once per frame (after buffer swap)
+
+    size_t FrameBytes() const { return m_lastFrameBytes; }  // bytes uploaded during the last completed frame
+    size_t TotalBytes() const { return m_totalBytes; }
+    bool   Persistent() const { return m_mappedData != NULL; }
+
+private:
+    struct FencedRange
+    {
+        GLsync sync;
+        size_t start;
+        size_t end;
+    };
+
+    UploadRing() : m_buffer(0), m_mappedData(NULL), m_head(0), m_stagedStart(0), m_staged(false),
+                   m_frameBytes(0), m_lastFrameBytes(0), m_totalBytes(0)
+    {
+    }
+
+    bool WaitForRange(size_t start, size_t end);  // false if the GPU didn't release the range in time
+
+    GLuint m_buffer;
+    unsigned char *m_mappedData;  // persistent mapping (NULL if ranges are mapped per upload)
+    size_t m_head;                // next free byte
+    size_t m_stagedStart;
+    bool   m_staged;              // ring is bound with an upload in flight
+
+    std::deque<FencedRange> m_fences;   // uploads the GPU may still be reading, oldest first
+
+    size_t m_frameBytes;
+    size_t m_lastFrameBytes;
+    size_t m_totalBytes;
+};
+
+#endif
\ No newline at end of file